@@ -0,0 +1,138 @@
+#include "analysisthread.h"
+#include "elements.h"
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QStringList>
+
+// sem quadro novo, olha de novo depois disso (ms)
+static const int PollInterval = 10;
+
+AnalysisThread::AnalysisThread(QObject *parent)
+    : QThread(parent), exportInterval(1000)
+{
+}
+
+AnalysisThread::~AnalysisThread()
+{
+    stop();
+}
+
+void AnalysisThread::stop()
+{
+    requestInterruption();
+    wait();
+}
+
+// serie.csv -> serie-rdf.csv, ao lado
+void AnalysisThread::setExport(const QString &fileName, int intervalMs)
+{
+    seriesName = fileName;
+    exportInterval = intervalMs;
+    rdfName.clear();
+    if(fileName.isEmpty())
+        return;
+    QFileInfo info(fileName);
+    QString suffix = info.suffix().isEmpty() ? QString("csv") : info.suffix();
+    rdfName = info.dir().filePath(info.completeBaseName() + "-rdf." + suffix);
+}
+
+void AnalysisThread::offer(const SimFrame &frame)
+{
+    // a analise ainda nao pegou o anterior: nem copia, ela esta atrasada
+    if(frames.pending())
+        return;
+    // o vetor do buffer guarda a capacidade: depois do primeiro, so copia
+    frames.writeBuffer() = frame;
+    frames.publish();
+}
+
+const ObservableReport *AnalysisThread::takeReport()
+{
+    if(!reports.update())
+        return 0;
+    return &reports.readBuffer();
+}
+
+bool AnalysisThread::writeExport(const ObservableReport &report, bool first)
+{
+    TRACE_ZONE("writeExport");
+    QFile series(seriesName);
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Text;
+    if(!series.open(first ? mode : mode | QIODevice::Append))
+        return false;
+
+    QStringList parts;
+    for(size_t s = 0; s < report.species.size(); s++)
+        parts << QString("%1:%2").arg(QString::fromStdString(report.species[s].first))
+                 .arg(report.species[s].second);
+
+    QTextStream out(&series);
+    if(first)
+        out << "step,samples,temperature,mean_temperature,sd_temperature,"
+               "kinetic,potential,reactions,rate,mean_rate,species\n";
+    out << report.step << ',' << report.samples << ','
+        << report.temperature << ',' << report.meanTemperature << ','
+        << report.sdTemperature << ',' << report.kineticEnergy << ','
+        << report.potentialEnergy << ',' << report.reactions << ','
+        << report.reactionRate << ',' << report.meanRate << ','
+        << parts.join(' ') << '\n';
+
+    // a g(r) e a media desde o inicio: o arquivo e reescrito inteiro
+    QFile rdf(rdfName);
+    if(!rdf.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    QTextStream table(&rdf);
+    table << "r";
+    for(size_t c = 0; c < report.rdf.size(); c++)
+        table << ',' << elementInfo(report.rdf[c].elementA).symbol
+              << '-' << elementInfo(report.rdf[c].elementB).symbol;
+    table << '\n';
+    size_t bins = report.rdf.empty() ? 0 : report.rdf[0].g.size();
+    for(size_t k = 0; k < bins; k++)
+    {
+        table << (k + 0.5) * report.rdfBin;
+        for(size_t c = 0; c < report.rdf.size(); c++)
+            table << ',' << report.rdf[c].g[k];
+        table << '\n';
+    }
+    return true;
+}
+
+void AnalysisThread::run()
+{
+    TRACE_THREAD("analysis");
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastExport = 0;
+    bool first = true;
+
+    while(!isInterruptionRequested())
+    {
+        if(!frames.update())
+        {
+            msleep(PollInterval);
+            continue;
+        }
+        {
+            TRACE_ZONE("Observables::add");
+            observables.add(frames.readBuffer());
+        }
+
+        // exporta antes de publicar: depois disso o buffer e da janela
+        ObservableReport &report = reports.writeBuffer();
+        observables.report(report);
+        if(!seriesName.isEmpty() && (first || clock.elapsed() - lastExport >= exportInterval))
+        {
+            if(!writeExport(report, first))
+                qWarning("nao consegui gravar %s", qPrintable(seriesName));
+            first = false;
+            lastExport = clock.elapsed();
+        }
+        reports.publish();
+    }
+}
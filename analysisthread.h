@@ -0,0 +1,48 @@
+#ifndef ANALYSISTHREAD_H
+#define ANALYSISTHREAD_H
+
+#include <QThread>
+#include <QString>
+#include <atomic>
+
+#include "observables.h"
+#include "triplebuffer.h"
+
+// Roda o Observables fora da fisica. A SimulationThread (ou o viewer)
+// oferece cada quadro com offer(), que so copia para um TripleBuffer e
+// volta; esta thread pega o ultimo que chegou, e os que passaram enquanto
+// ela analisava ficam de fora. O resultado volta para a janela por outro
+// TripleBuffer.
+//
+// Com setExport() o relatorio vai para arquivos de tempos em tempos: uma
+// linha por exportacao na serie e a g(r) inteira, reescrita, ao lado.
+class AnalysisThread : public QThread
+{
+public:
+    explicit AnalysisThread(QObject *parent = 0);
+    ~AnalysisThread();
+
+    void stop();
+    void setExport(const QString &fileName, int intervalMs = 1000);
+
+    // lado de quem produz quadros: nunca espera
+    void offer(const SimFrame &frame);
+
+    // lado da janela: o relatorio mais novo, ou 0 se nao mudou
+    const ObservableReport *takeReport();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    TripleBuffer<SimFrame> frames;
+    TripleBuffer<ObservableReport> reports;
+    Observables observables;
+
+    QString seriesName;
+    QString rdfName;
+    int exportInterval;
+    bool writeExport(const ObservableReport &report, bool first);
+};
+
+#endif // ANALYSISTHREAD_H
@@ -38,164 +38,202 @@
 **
 ****************************************************************************/
 
-#include "edge.h"
 #include "atom.h"
 #include "graphwidget.h"
 #include "atomstruct.h"
+#include "trace.h"
 
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
 #include <QPainter>
 #include <QStyleOption>
 #include <QString>
+#include <QStaticText>
+#include <QPixmap>
+#include <QImage>
+#include <QHash>
 #include <QDebug>
 
-Atom::Atom(GraphWidget *graphWidget, struct atomType atomIn)
-    : graph(graphWidget)
+// Tudo que e igual para os atomos de um mesmo elemento: o tamanho, as
+// cores, a bolinha ja desenhada e o nome ja diagramado. Fica num cache
+// pelo atomType inteiro (visualKey) e cada Atom so guarda o ponteiro
+// (flyweight).
+struct AtomVisual
 {
-    setFlag(QGraphicsItem::ItemIgnoresTransformations); // a luz nao pode rodar.
-    setFlag(ItemSendsGeometryChanges); // quando o cara e movimentado voce manda um aviso
-    setCacheMode(DeviceCoordinateCache);// otimiza renderizacao
-    setZValue(-1);
-
-    //characteristics
-    vel.setX(0);
-    vel.setY(0);
-    xInitialDraw = -atomIn.r;
-    yInitialDraw = xInitialDraw;
-    horizSize = -2 * xInitialDraw;
-    vertSize = -2 * xInitialDraw;
-    adjustBoundingSize = 2;
-
-    lightColor.setNamedColor(atomIn.lightColor);
-    darkColor.setNamedColor(atomIn.darkColor);
-
-    if(atomIn.atomName != "")
-    {
-        name = new QGraphicsSimpleTextItem(this);
-        name->setFlag(QGraphicsItem::ItemIgnoresTransformations);
-        name->setText(atomIn.atomName);
-        name->setPos((int)(xInitialDraw/2),-3 + (int)(yInitialDraw/2));
-        name->setFont(QFont("Times", -xInitialDraw, QFont::Bold));
-        name->hide();
-    }
-
-}
-
-void Atom::addEdge(Edge *edge)
+    // creating figure
+    qreal xInitialDraw;
+    qreal yInitialDraw;
+    qreal horizSize;
+    qreal vertSize;
+    qreal adjustBoundingSize;
+    QColor lightColor;
+    QColor darkColor;
+
+    QRectF body;
+    QPixmap sprite;
+    QPointF spritePos;
+    // o nome so e diagramado quando os rotulos aparecem pela primeira vez:
+    // criar a QFont na abertura carrega o banco de fontes inteiro
+    QString name;
+    mutable QStaticText label;
+    mutable bool labelReady;
+    QPointF labelPos;
+    bool hasLabel;
+    QRectF bounds;
+};
+
+static QHash<QString, AtomVisual *> &visualCache()
 {
-    edgeList << edge;
-    edge->adjust();
+    static QHash<QString, AtomVisual *> cache;
+    return cache;
 }
 
-QList<Edge *> Atom::edges() const
+// Tudo que o atomType tem entra na chave: dois tipos com o mesmo nome e
+// raio ou cor diferentes nao podem dividir o sprite.
+static QString visualKey(const struct atomType &atomIn)
 {
-    return edgeList;
+    return QString("%1|%2|%3|%4").arg(atomIn.atomName, QString::number(atomIn.r, 'g', 9),
+                                      atomIn.lightColor, atomIn.darkColor);
 }
-//! [1]
 
-void Atom::setVel(QPointF newVel)
+bool Atom::showLabels = false;
+
+Atom::Atom(GraphWidget *graphWidget, struct atomType atomIn)
+    : graph(graphWidget)
 {
-    vel = newVel;
+    setFlag(QGraphicsItem::ItemIgnoresTransformations); // a luz nao pode rodar.
+    setFlag(ItemSendsGeometryChanges); // quando o cara e movimentado voce manda um aviso
+    // sem DeviceCoordinateCache: o sprite do elemento ja vem desenhado (findVisual)
+    setZValue(-1);
+
+    setAtomType(atomIn);
 }
 
-void Atom::changeVel(QPointF addVel)
+// Os itens sao reaproveitados para atomos de outro elemento conforme a
+// area visivel muda, entao a aparencia pode ser trocada depois.
+void Atom::setAtomType(const struct atomType &atomIn)
 {
-    vel += addVel;
+    prepareGeometryChange();
+    visual = findVisual(atomIn);
 }
 
-void Atom::showHideLabels(bool showLabel)
+const AtomVisual *Atom::findVisual(const struct atomType &atomIn)
 {
-    if(showLabel)
-        name->show();
-    else
-        name->hide();
+    QString key = visualKey(atomIn);
+    AtomVisual *cached = visualCache().value(key);
+    if(cached)
+        return cached;
+
+    cached = new AtomVisual;
+    describe(atomIn, *cached);
+    cached->sprite = QPixmap::fromImage(renderSprite(atomIn, 1, false, cached->spritePos));
+    cached->labelReady = false;
+
+    visualCache().insert(key, cached);
+    return cached;
 }
 
-void Atom::invertVel(int bounceType)
+// Tamanho, cores e limites do elemento, sem desenhar nada.
+void Atom::describe(const struct atomType &atomIn, AtomVisual &geometry)
 {
-    switch(bounceType)
+    //characteristics
+    geometry.xInitialDraw = -atomIn.r;
+    geometry.yInitialDraw = geometry.xInitialDraw;
+    geometry.horizSize = -2 * geometry.xInitialDraw;
+    geometry.vertSize = -2 * geometry.xInitialDraw;
+    geometry.adjustBoundingSize = 2;
+    geometry.lightColor.setNamedColor(atomIn.lightColor);
+    geometry.darkColor.setNamedColor(atomIn.darkColor);
+
+    qreal xInitialDraw = geometry.xInitialDraw;
+    qreal yInitialDraw = geometry.yInitialDraw;
+    qreal adjustBoundingSize = geometry.adjustBoundingSize;
+    geometry.body = QRectF(
+                xInitialDraw - adjustBoundingSize ,
+                yInitialDraw - adjustBoundingSize,
+                geometry.horizSize + adjustBoundingSize + 3,
+                geometry.vertSize + adjustBoundingSize + 3);
+    geometry.spritePos = geometry.body.topLeft();
+
+    geometry.name = atomIn.atomName;
+    geometry.hasLabel = (atomIn.atomName != "");
+    geometry.bounds = geometry.body;
+    if(geometry.hasLabel)
     {
-    case 1:
-        setVel(QPointF(-vel.x(),vel.y()));
-        break;
-    case 2:
-        setVel(QPointF(vel.x(),-vel.y()));
-        break;
-    case 3:
-        setVel(QPointF(-vel.x(),-vel.y()));
-        break;
+        // sem a fonte, uma estimativa folgada do tamanho do nome
+        geometry.labelPos = QPointF((int)(xInitialDraw/2),-3 + (int)(yInitialDraw/2));
+        geometry.bounds |= QRectF(geometry.labelPos,
+                                  QSizeF(-xInitialDraw * geometry.name.size(), -2 * xInitialDraw));
     }
 }
 
-
-QPointF Atom::getVel()
-{
-    return vel;
-}
-
-qreal Atom::getRadius()
+// Com scale 1 e sem nome e o sprite do cache. O nome aqui e desenhado
+// com drawText, sem QStaticText: a imagem e feita uma vez so.
+QImage Atom::renderSprite(const struct atomType &atomIn, qreal scale, bool label,
+                          QPointF &origin)
 {
-    return -xInitialDraw;
+    AtomVisual geometry;
+    describe(atomIn, geometry);
+    QRectF area = label && geometry.hasLabel ? geometry.bounds : geometry.body;
+    origin = area.topLeft() * scale;
+
+    QImage sprite((area.size() * scale).toSize().expandedTo(QSize(1, 1)),
+                  QImage::Format_ARGB32_Premultiplied);
+    sprite.fill(Qt::transparent);
+    QPainter spritePainter(&sprite);
+    spritePainter.setRenderHint(QPainter::Antialiasing);
+    spritePainter.scale(scale, scale);
+    spritePainter.translate(-area.topLeft());
+    paintBody(&spritePainter, geometry);
+    if(label && geometry.hasLabel)
+    {
+        QFont font("Times", -geometry.xInitialDraw, QFont::Bold);
+        spritePainter.setFont(font);
+        spritePainter.setPen(Qt::black);
+        spritePainter.drawText(QRectF(geometry.labelPos, geometry.bounds.bottomRight()),
+                               Qt::AlignLeft | Qt::AlignTop, geometry.name);
+    }
+    spritePainter.end();
+    return sprite;
 }
 
-void Atom::setAtomPosition(QPointF newPosition)
-{
-    atomPosition = newPosition;
-}
+//! [1]
 
-QPointF Atom::getAtomPosition() const
+void Atom::setLabelsVisible(bool visible)
 {
-    return atomPosition;
+    showLabels = visible;
 }
 
-void Atom::activateDeactivateRotations(bool rotOnOff)
+bool Atom::labelsVisible()
 {
-    setFlag(QGraphicsItem::ItemIgnoresTransformations,rotOnOff);
+    return showLabels;
 }
 
-
-int Atom::checkBounce()
+qreal Atom::getRadius() const
 {
-    QRectF sceneRect = scene()->sceneRect();
-    QPointF actualPosition = atomPosition;
-    qreal safeSize = 5 * adjustBoundingSize;
-    int bounce = 0;
-    if(
-            ((sceneRect.left() + xInitialDraw + horizSize + safeSize) > actualPosition.x())||
-            ((sceneRect.right() - xInitialDraw - horizSize - safeSize) < actualPosition.x()))
-        bounce += 1;
-    if(
-            ((sceneRect.top() + yInitialDraw + vertSize + safeSize) > actualPosition.y())||
-            ((sceneRect.bottom() - yInitialDraw - vertSize - safeSize) < actualPosition.y()))
-        bounce += 2;
-
-    return bounce;
+    return -visual->xInitialDraw;
 }
 
-void Atom::calculateForces()
+int Atom::visualCount()
 {
-    newPos = pos() + vel;
+    return visualCache().size();
 }
 
-
-
-bool Atom::advance()
+// Aproximado: a estrutura mais os pixels do sprite.
+int Atom::visualBytes()
 {
-    if (newPos == pos())
-        return false;
-
-    setPos(newPos);
-    return true;
+    int bytes = 0;
+    foreach(const AtomVisual *cached, visualCache())
+    {
+        bytes += sizeof(AtomVisual);
+        bytes += cached->sprite.width() * cached->sprite.height() * cached->sprite.depth() / 8;
+    }
+    return bytes;
 }
 
 QRectF Atom::boundingRect() const
 {
-    return QRectF(
-                xInitialDraw - adjustBoundingSize ,
-                yInitialDraw - adjustBoundingSize,
-                horizSize + adjustBoundingSize + 3,
-                vertSize + adjustBoundingSize + 3);
+    return visual->bounds;
 }
 
 // SE NAO DEFINIR ISSO AQUI A FIGURA VIRA UM RETANGULO
@@ -203,19 +241,50 @@ QRectF Atom::boundingRect() const
 QPainterPath Atom::shape() const
 {
     QPainterPath path;
-    path.addEllipse(xInitialDraw, yInitialDraw, horizSize, vertSize);
+    path.addEllipse(visual->xInitialDraw, visual->yInitialDraw,
+                    visual->horizSize, visual->vertSize);
     return path;
 }
 
 void Atom::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
 {
+    TRACE_ZONE("Atom::paint");
+    Q_UNUSED(option);
+
+    painter->drawPixmap(visual->spritePos, visual->sprite);
+    if(showLabels && visual->hasLabel)
+    {
+        if(!visual->labelReady)
+            prepareLabel(*visual);
+        // a fonte ja esta no QStaticText, so falta a cor
+        painter->setPen(Qt::black);
+        painter->drawStaticText(visual->labelPos, visual->label);
+    }
+}
+
+void Atom::prepareLabel(const AtomVisual &cached)
+{
+    QFont font("Times", -cached.xInitialDraw, QFont::Bold);
+    cached.label.setTextFormat(Qt::PlainText);
+    cached.label.setText(cached.name);
+    cached.label.prepare(QTransform(), font);
+    cached.labelReady = true;
+}
+
+void Atom::paintBody(QPainter *painter, const AtomVisual &geometry)
+{
+    qreal xInitialDraw = geometry.xInitialDraw;
+    qreal yInitialDraw = geometry.yInitialDraw;
+    qreal horizSize = geometry.horizSize;
+    qreal vertSize = geometry.vertSize;
+
     painter->setPen(Qt::NoPen);
     painter->setBrush(Qt::darkBlue);
     painter->drawEllipse(xInitialDraw +3, yInitialDraw +3, horizSize, vertSize);
 
     QRadialGradient gradient((int)(xInitialDraw/3), (int)(xInitialDraw/3), (int)(horizSize/2));
-    gradient.setColorAt(0, lightColor);
-    gradient.setColorAt(1, darkColor);
+    gradient.setColorAt(0, geometry.lightColor);
+    gradient.setColorAt(1, geometry.darkColor);
 
     painter->setBrush(gradient);
     painter->setPen(QPen(Qt::black, 0));
@@ -226,8 +295,6 @@ QVariant Atom::itemChange(GraphicsItemChange change, const QVariant &value)
 {
     switch (change) {
     case ItemPositionHasChanged:
-        foreach (Edge *edge, edgeList)
-            edge->adjust();
         graph->itemMoved();
         break;
     default:
@@ -44,11 +44,12 @@
 #include <QGraphicsItem>
 #include <QList>
 #include <QPainter>
+#include <QImage>
 
 #include "atomstruct.h"
 
-class Edge;
 class GraphWidget;
+struct AtomVisual;
 QT_BEGIN_NAMESPACE
 class QGraphicsSceneMouseEvent;
 QT_END_NAMESPACE
@@ -58,30 +59,30 @@ class Atom : public QGraphicsItem
 public:
     Atom(GraphWidget *graphWidget, struct atomType atomIn);
 
-    void addEdge(Edge *edge);
-    QList<Edge *> edges() const;
+    void setAtomType(const struct atomType &atomIn);
 
     enum { Type = UserType + 1 };
     int type() const Q_DECL_OVERRIDE { return Type; }
 
-    void calculateForces();
-    bool advance();
-
     QRectF boundingRect() const Q_DECL_OVERRIDE;
     QPainterPath shape() const Q_DECL_OVERRIDE;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) Q_DECL_OVERRIDE;
 
-    void setVel(QPointF newVel);
-    void changeVel(QPointF addVel);
-    void invertVel(int bounceType);
-    QPointF getVel();
-    qreal getRadius();
-    void setAtomPosition(QPointF newPosition);
-    QPointF getAtomPosition() const;
+    qreal getRadius() const;
+
+    // um unico flag para todos os atomos, lido no paint
+    static void setLabelsVisible(bool visible);
+    static bool labelsVisible();
+
+    // memoria do lado do desenho: o item e o que ele divide com os outros
+    static int visualCount();
+    static int visualBytes();
 
-    int checkBounce();//0-no | 1-x | 2-y | 3-xy
-    void showHideLabels(bool showLabel);
-    void activateDeactivateRotations(bool rotOnOff);
+    // O mesmo desenho do paint numa QImage, em escala e com o nome ja
+    // escrito, para quem pinta fora da cena (FrameExporter). origin volta
+    // com o canto da imagem em relacao ao centro do atomo, ja escalado.
+    static QImage renderSprite(const struct atomType &atomIn, qreal scale, bool label,
+                               QPointF &origin);
 
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) Q_DECL_OVERRIDE;
@@ -90,24 +91,16 @@ protected:
     void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) Q_DECL_OVERRIDE;
 
 private:
-    QList<Edge *> edgeList;
-    QPointF newPos;
+    // o resto (tamanho, cores, sprite, nome) e do elemento, no AtomVisual
     GraphWidget *graph;
-    QGraphicsSimpleTextItem *name;
-    QPointF vel;
-    QPointF atomPosition;
-
-
-    // creating figure
-    qreal xInitialDraw;
-    qreal yInitialDraw;
-    qreal horizSize;
-    qreal vertSize;
-    qreal adjustBoundingSize;
-    QColor lightColor;
-    QColor darkColor;
+    const AtomVisual *visual;
 
+    static const AtomVisual *findVisual(const struct atomType &atomIn);
+    static void describe(const struct atomType &atomIn, AtomVisual &geometry);
+    static void prepareLabel(const AtomVisual &cached);
+    static void paintBody(QPainter *painter, const AtomVisual &geometry);
 
+    static bool showLabels;
 };
 //! [0]
 
@@ -0,0 +1,145 @@
+#include "bondtopology.h"
+
+#include <math.h>
+#include <algorithm>
+#include <map>
+
+BondTopology::BondTopology()
+    : valid(false)
+{
+}
+
+void BondTopology::build(const std::vector<SimAtom> &atoms, const std::vector<SimBond> &bonds)
+{
+    int n = (int)atoms.size();
+    valid = true;
+
+    activeBonds.clear();
+    start.assign(n + 1, 0);
+    for(int b = 0; b < (int)bonds.size(); b++)
+    {
+        if(!bonds[b].visible)
+            continue;
+        activeBonds.push_back(b);
+        start[bonds[b].a + 1]++;
+        start[bonds[b].b + 1]++;
+    }
+    for(int i = 0; i < n; i++)
+        start[i + 1] += start[i];
+
+    partners.resize(start[n]);
+    bondIndex.resize(start[n]);
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for(size_t k = 0; k < activeBonds.size(); k++)
+    {
+        const SimBond &bond = bonds[activeBonds[k]];
+        partners[fill[bond.a]] = bond.b;
+        bondIndex[fill[bond.a]++] = activeBonds[k];
+        partners[fill[bond.b]] = bond.a;
+        bondIndex[fill[bond.b]++] = activeBonds[k];
+    }
+
+    // O angulo de repouso e o da geometria quando o angulo aparece pela
+    // primeira vez. Os que ja existiam antes desta reconstrucao guardam o
+    // seu: qualquer ligacao que forma ou quebra reconstroi tudo, e sem
+    // isso cada angulo da cena passaria a repousar na forma deformada
+    // daquele momento.
+    typedef std::pair<int, std::pair<int, int> > AngleKey; // vertice, pontas em ordem
+    std::map<AngleKey, double> previous;
+    for(size_t k = 0; k < angleRest.size(); k++)
+    {
+        int a = angleA[k], c = angleC[k];
+        previous[AngleKey(angleB[k], std::make_pair(std::min(a, c), std::max(a, c)))] = angleRest[k];
+    }
+
+    angleA.clear();
+    angleB.clear();
+    angleC.clear();
+    angleRest.clear();
+    for(int b = 0; b < n; b++)
+    {
+        for(int p = start[b]; p < start[b + 1]; p++)
+        {
+            for(int q = p + 1; q < start[b + 1]; q++)
+            {
+                int a = partners[p];
+                int c = partners[q];
+                angleA.push_back(a);
+                angleB.push_back(b);
+                angleC.push_back(c);
+
+                std::map<AngleKey, double>::const_iterator known =
+                        previous.find(AngleKey(b, std::make_pair(std::min(a, c), std::max(a, c))));
+                if(known != previous.end())
+                {
+                    angleRest.push_back(known->second);
+                    continue;
+                }
+                double ax = atoms[a].x - atoms[b].x;
+                double ay = atoms[a].y - atoms[b].y;
+                double cx = atoms[c].x - atoms[b].x;
+                double cy = atoms[c].y - atoms[b].y;
+                angleRest.push_back(atan2(fabs(ax * cy - ay * cx), ax * cx + ay * cy));
+            }
+        }
+    }
+}
+
+void BondTopology::addForces(const std::vector<SimAtom> &atoms, const std::vector<SimBond> &bonds,
+                             double bondK, double angleK,
+                             std::vector<double> &fx, std::vector<double> &fy) const
+{
+    // E = k/2 (r - r0)^2
+    for(size_t k = 0; k < activeBonds.size(); k++)
+    {
+        const SimBond &bond = bonds[activeBonds[k]];
+        double dx = atoms[bond.b].x - atoms[bond.a].x;
+        double dy = atoms[bond.b].y - atoms[bond.a].y;
+        double r = sqrt(dx * dx + dy * dy);
+        if(r < 1e-9)
+            continue;
+        double f = bondK * (r - bond.restLength) / r;
+        fx[bond.a] += f * dx;
+        fy[bond.a] += f * dy;
+        fx[bond.b] -= f * dx;
+        fy[bond.b] -= f * dy;
+    }
+
+    // E = k/2 (theta - theta0)^2
+    for(size_t k = 0; k < angleRest.size(); k++)
+    {
+        int a = angleA[k];
+        int b = angleB[k];
+        int c = angleC[k];
+        double ax = atoms[a].x - atoms[b].x;
+        double ay = atoms[a].y - atoms[b].y;
+        double cx = atoms[c].x - atoms[b].x;
+        double cy = atoms[c].y - atoms[b].y;
+        double ra2 = ax * ax + ay * ay;
+        double rc2 = cx * cx + cy * cy;
+        double rarc = sqrt(ra2 * rc2);
+        if(rarc < 1e-9)
+            continue;
+
+        double cosTheta = (ax * cx + ay * cy) / rarc;
+        if(cosTheta > 1) cosTheta = 1;
+        if(cosTheta < -1) cosTheta = -1;
+        double theta = acos(cosTheta);
+        double sinTheta = sqrt(1 - cosTheta * cosTheta);
+        if(sinTheta < 1e-3)
+            sinTheta = 1e-3;
+
+        // F = -dE/dtheta * dtheta/dr, com dtheta/dr = -dcos/dr / sin
+        double g = angleK * (theta - angleRest[k]) / sinTheta;
+        double fax = g * (cx / rarc - cosTheta * ax / ra2);
+        double fay = g * (cy / rarc - cosTheta * ay / ra2);
+        double fcx = g * (ax / rarc - cosTheta * cx / rc2);
+        double fcy = g * (ay / rarc - cosTheta * cy / rc2);
+        fx[a] += fax;
+        fy[a] += fay;
+        fx[c] += fcx;
+        fy[c] += fcy;
+        fx[b] -= fax + fcx;
+        fy[b] -= fay + fcy;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef BONDTOPOLOGY_H
+#define BONDTOPOLOGY_H
+
+#include <vector>
+
+#include "simtypes.h"
+
+// Ligacoes ativas de cada atomo em CSR (start/partners/bondIndex) e a
+// lista de angulos derivada delas. Usada pelo modo flexivel, que troca o
+// corpo rigido por molas harmonicas de ligacao e de angulo. So precisa
+// ser reconstruida quando uma ligacao aparece ou some.
+class BondTopology
+{
+public:
+    BondTopology();
+
+    void invalidate() { valid = false; }
+    bool isValid() const { return valid; }
+    void build(const std::vector<SimAtom> &atoms, const std::vector<SimBond> &bonds);
+
+    int begin(int atom) const { return start[atom]; }
+    int end(int atom) const { return start[atom + 1]; }
+    int partner(int k) const { return partners[k]; }
+    int bondAt(int k) const { return bondIndex[k]; }
+    int angleCount() const { return (int)angleRest.size(); }
+    size_t memoryUsage() const
+    {
+        return vectorBytes(start) + vectorBytes(partners) + vectorBytes(bondIndex) +
+                vectorBytes(activeBonds) + vectorBytes(angleA) + vectorBytes(angleB) +
+                vectorBytes(angleC) + vectorBytes(angleRest);
+    }
+
+    void addForces(const std::vector<SimAtom> &atoms, const std::vector<SimBond> &bonds,
+                   double bondK, double angleK,
+                   std::vector<double> &fx, std::vector<double> &fy) const;
+
+private:
+    bool valid;
+
+    std::vector<int> start;
+    std::vector<int> partners;
+    std::vector<int> bondIndex;
+    std::vector<int> activeBonds;
+
+    // angulo a-b-c com vertice em b
+    std::vector<int> angleA, angleB, angleC;
+    std::vector<double> angleRest;
+};
+
+#endif // BONDTOPOLOGY_H
@@ -0,0 +1,260 @@
+#include "bulksolution.h"
+#include "elements.h"
+#include "reactionrules.h"
+#include "trace.h"
+
+#include <math.h>
+#include <algorithm>
+
+static const double Pi = 3.14159265358979323846264338327950288419717;
+
+namespace {
+
+// As especies da solucao; as regras vem de reactionrules.h. element/ligand
+// dizem como desenhar (OH- e um O com um H ligado); a agua e o solvente e
+// nao aparece.
+struct SpeciesInfo
+{
+    const char *name;
+    int element;
+    int ligand;
+};
+
+const SpeciesInfo solutionSpecies[] =
+{
+    { "H2O", 0, 0 },
+    { "H+", 1, 0 },
+    { "OH-", 8, 1 }
+};
+
+// 0,1 pL: 6000 H+ em pH 7. Um passo da simulacao vale 1 us da solucao,
+// e o equilibrio volta em algumas dezenas de passos.
+const double Volume = 1e-13;
+const double SecondsPerStep = 1e-6;
+const double OneIon = 1 / (6.02214076e23 * Volume); // mol/L
+
+const int MaxMarkers = 150;
+const double Diffusion = 3;     // desvio do passeio por passo
+const double LigandSpin = 10;   // graus por passo
+
+int speciesIndex(const StochasticKinetics &kinetics, const char *name)
+{
+    return name ? kinetics.findSpecies(name) : -1;
+}
+
+bool hasSpecies(const StochasticKinetics &kinetics, const ReactionRule &rule)
+{
+    for(int i = 0; i < 2; i++)
+    {
+        if(rule.reactants[i] && kinetics.findSpecies(rule.reactants[i]) < 0)
+            return false;
+        if(rule.products[i] && kinetics.findSpecies(rule.products[i]) < 0)
+            return false;
+    }
+    return true;
+}
+
+}
+
+BulkSolution::BulkSolution()
+    : enabled(false), hydrogen(-1), hydroxide(-1), perMarker(1)
+{
+}
+
+void BulkSolution::setup(double pH, const SimBox &box, unsigned seed)
+{
+    bulk = StochasticKinetics(seed);
+    bulk.setVolume(Volume);
+    random.seed(seed);
+    element.clear();
+    ligand.clear();
+    markers.clear();
+
+    int species = sizeof(solutionSpecies) / sizeof(solutionSpecies[0]);
+    for(int i = 0; i < species; i++)
+    {
+        bulk.addSpecies(solutionSpecies[i].name, 0);
+        element.push_back(solutionSpecies[i].element);
+        ligand.push_back(solutionSpecies[i].ligand);
+    }
+    // so as regras com taxa cujas especies a solucao tem; as de contato
+    // sao da PairPotentials
+    for(int j = 0; j < reactionRuleCount(); j++)
+    {
+        const ReactionRule &rule = reactionRule(j);
+        if(rule.rate <= 0 || !hasSpecies(bulk, rule))
+            continue;
+        bulk.addRule(speciesIndex(bulk, rule.reactants[0]), speciesIndex(bulk, rule.reactants[1]),
+                     speciesIndex(bulk, rule.products[0]), speciesIndex(bulk, rule.products[1]),
+                     rule.rate);
+    }
+    shown.assign(species, 0);
+
+    hydrogen = bulk.findSpecies("H+");
+    hydroxide = bulk.findSpecies("OH-");
+    bulk.addConcentration(bulk.findSpecies("H2O"), WaterMolar);
+    bulk.addConcentration(hydrogen, pow(10, -pH));
+    bulk.addConcentration(hydroxide, pow(10, pH - 14));
+
+    enabled = true;
+    updateScale();
+    syncMarkers(box);
+}
+
+void BulkSolution::addAcid(double molar)
+{
+    if(enabled)
+        bulk.addConcentration(hydrogen, molar);
+}
+
+void BulkSolution::addBase(double molar)
+{
+    if(enabled)
+        bulk.addConcentration(hydroxide, molar);
+}
+
+double BulkSolution::pH() const
+{
+    // sem nenhum H+ no volume, o melhor que da para dizer e "menos de um"
+    return -log10(std::max(bulk.concentration(hydrogen), OneIon));
+}
+
+void BulkSolution::step(const SimBox &box)
+{
+    if(!enabled)
+        return;
+    TRACE_ZONE("BulkSolution::step");
+    bulk.advance(SecondsPerStep);
+    updateScale();
+    syncMarkers(box);
+    diffuse(box);
+}
+
+void BulkSolution::updateScale()
+{
+    long long most = 0;
+    for(int i = 0; i < bulk.speciesCount(); i++)
+    {
+        if(element[i])
+            most = std::max(most, bulk.count(i));
+    }
+    // sobe quando passa do limite, desce so com folga de 10x
+    while(most / perMarker > MaxMarkers)
+        perMarker *= 10;
+    while(perMarker > 1 && most / perMarker < MaxMarkers / 10.0)
+        perMarker /= 10;
+}
+
+// Quantos marcadores cada especie deve ter agora. Os que sobram saem ao
+// acaso e os que faltam aparecem em lugar qualquer da caixa.
+void BulkSolution::syncMarkers(const SimBox &box)
+{
+    std::uniform_real_distribution<double> px(box.left, box.left + box.width);
+    std::uniform_real_distribution<double> py(box.top, box.top + box.height);
+    std::uniform_real_distribution<double> turn(0, 360);
+
+    for(int i = 0; i < bulk.speciesCount(); i++)
+    {
+        if(!element[i])
+            continue;
+        int target = (int)llround(bulk.count(i) / perMarker);
+        while(shown[i] > target)
+        {
+            // um marcador qualquer desta especie
+            std::uniform_int_distribution<int> pick(0, shown[i] - 1);
+            int skip = pick(random);
+            for(size_t k = 0; k < markers.size(); k++)
+            {
+                if(markers[k].species != i || skip-- > 0)
+                    continue;
+                markers[k] = markers.back();
+                markers.pop_back();
+                break;
+            }
+            shown[i]--;
+        }
+        while(shown[i] < target)
+        {
+            Marker marker;
+            marker.species = i;
+            marker.x = px(random);
+            marker.y = py(random);
+            marker.angle = turn(random);
+            markers.push_back(marker);
+            shown[i]++;
+        }
+    }
+}
+
+void BulkSolution::diffuse(const SimBox &box)
+{
+    std::normal_distribution<double> walk(0, Diffusion);
+    std::normal_distribution<double> spin(0, LigandSpin);
+    double right = box.left + box.width;
+    double bottom = box.top + box.height;
+    for(size_t k = 0; k < markers.size(); k++)
+    {
+        Marker &marker = markers[k];
+        marker.x += walk(random);
+        marker.y += walk(random);
+        marker.angle += spin(random);
+        // a mesma volta na caixa dos atomos
+        if(box.periodic)
+        {
+            box.wrap(marker.x, marker.y);
+            continue;
+        }
+        // reflete nas paredes
+        if(marker.x < box.left)
+            marker.x = 2 * box.left - marker.x;
+        if(marker.x > right)
+            marker.x = 2 * right - marker.x;
+        if(marker.y < box.top)
+            marker.y = 2 * box.top - marker.y;
+        if(marker.y > bottom)
+            marker.y = 2 * bottom - marker.y;
+    }
+}
+
+// As contagens e os marcadores; o gerador segue deles.
+void BulkSolution::addToHash(StateHash &hash) const
+{
+    if(!enabled)
+        return;
+    for(int i = 0; i < bulk.speciesCount(); i++)
+        hash.add((long long)bulk.count(i));
+    hash.add(perMarker);
+    for(size_t k = 0; k < markers.size(); k++)
+    {
+        hash.add(markers[k].species);
+        hash.add(markers[k].x);
+        hash.add(markers[k].y);
+        hash.add(markers[k].angle);
+    }
+}
+
+void BulkSolution::appendTo(SimFrame &frame) const
+{
+    if(!enabled)
+        return;
+    for(size_t k = 0; k < markers.size(); k++)
+    {
+        const Marker &marker = markers[k];
+        int center = (int)frame.x.size();
+        frame.x.push_back(marker.x);
+        frame.y.push_back(marker.y);
+        frame.element.push_back(element[marker.species]);
+
+        int other = ligand[marker.species];
+        if(!other)
+            continue;
+        double length = elementInfo(element[marker.species]).radius + elementInfo(other).radius;
+        double angle = marker.angle * Pi / 180;
+        frame.x.push_back(marker.x + length * cos(angle));
+        frame.y.push_back(marker.y + length * sin(angle));
+        frame.element.push_back(other);
+        frame.bondA.push_back(center);
+        frame.bondB.push_back(center + 1);
+        frame.bondVisible.push_back(1);
+    }
+}
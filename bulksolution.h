@@ -0,0 +1,65 @@
+#ifndef BULKSOLUTION_H
+#define BULKSOLUTION_H
+
+#include <vector>
+#include <random>
+
+#include "simtypes.h"
+#include "kinetics.h"
+#include "statehash.h"
+
+// A agua em volta das moleculas, para o pH: H+ e OH- sao so contagens
+// evoluidas pela StochasticKinetics com as regras com taxa de
+// reactionrules.h (a mesma tabela de onde a PairPotentials tira as
+// reacoes de contato), e so uma amostra deles vira atomo no quadro. Os
+// marcadores andam ao acaso (difusao), sem colidir com nada.
+//
+// Cada marcador vale ionsPerMarker() ions, o mesmo para todas as
+// especies, entao a proporcao na tela e a da cinetica. O valor e uma
+// potencia de 10 e so muda quando a especie mais numerosa passa de
+// MaxMarkers marcadores (ou cai bem abaixo), para a cena nao ser
+// redesenhada a cada flutuacao.
+class BulkSolution
+{
+public:
+    BulkSolution();
+
+    void setup(double pH, const SimBox &box, unsigned seed);
+    bool isEnabled() const { return enabled; }
+
+    void addAcid(double molar);
+    void addBase(double molar);
+    void step(const SimBox &box);
+
+    double pH() const;
+    double ionsPerMarker() const { return perMarker; }
+    const StochasticKinetics &kinetics() const { return bulk; }
+
+    // os marcadores entram no fim dos atomos e das ligacoes do quadro
+    void appendTo(SimFrame &frame) const;
+    size_t memoryUsage() const { return vectorBytes(markers); }
+    void addToHash(StateHash &hash) const;
+
+private:
+    struct Marker
+    {
+        int species;
+        double x, y;
+        double angle; // so para o OH-, onde fica o H
+    };
+
+    bool enabled;
+    StochasticKinetics bulk;
+    std::vector<int> element, ligand; // por especie; 0 = nao desenhada
+    int hydrogen, hydroxide;
+    std::vector<Marker> markers;
+    std::vector<int> shown; // marcadores por especie
+    double perMarker;
+    std::mt19937 random;
+
+    void updateScale();
+    void syncMarkers(const SimBox &box);
+    void diffuse(const SimBox &box);
+};
+
+#endif // BULKSOLUTION_H
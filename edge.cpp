@@ -39,82 +39,111 @@
 ****************************************************************************/
 
 #include "edge.h"
-#include "atom.h"
+#include "trace.h"
 
 #include <math.h>
 
 #include <QPainter>
+#include <QGraphicsScene>
 
 static const double Pi = 3.14159265358979323846264338327950288419717;
 static double TwoPi = 2.0 * Pi;
 
-Edge::Edge(Atom *sourceNode, Atom *destNode)
-    : arrowSize(1)
+Edge::Edge()
+    : bondIndex(-1), arrowSize(1)
 {
     setAcceptedMouseButtons(0);
-    source = sourceNode;
-    dest = destNode;
-    source->addEdge(this);
-    dest->addEdge(this);
-    adjust();
 }
 
-Atom *Edge::sourceNode() const
+void Edge::setBond(int bond)
 {
-    return source;
+    bondIndex = bond;
 }
 
-Atom *Edge::destNode() const
+int Edge::bond() const
 {
-    return dest;
+    return bondIndex;
 }
 
-void Edge::adjust()
+void Edge::adjust(const QPointF &source, qreal sourceRadius,
+                  const QPointF &dest, qreal destRadius,
+                  const QPointF &destShift)
 {
-    if (!source || !dest)
-        return;
+    QLineF line = trimmed(QLineF(mapFromScene(source), mapFromScene(dest + destShift)),
+                          sourceRadius, destRadius);
+    QPointF newSource = line.p1();
+    QPointF newDest = line.p2();
 
-    QLineF line(mapFromItem(source, 0, 0), mapFromItem(dest, 0, 0));
-    qreal length = line.length();
+    // ligacao parada (molecula dormindo): nada a redesenhar
+    if (newSource == sourcePoint && newDest == destPoint && destShift == wrapShift)
+        return;
 
     prepareGeometryChange();
+    sourcePoint = newSource;
+    destPoint = newDest;
+    wrapShift = destShift;
+}
+
+QLineF Edge::trimmed(const QLineF &line, qreal sourceRadius, qreal destRadius)
+{
+    qreal length = line.length();
 
     // vector + radius to set initial point of lines
     if (length > qreal(20.)) {
-        qreal xSource = (line.dx() / length) * source->getRadius();
-        qreal ySource = (line.dy() / length) * source->getRadius();
+        qreal xSource = (line.dx() / length) * sourceRadius;
+        qreal ySource = (line.dy() / length) * sourceRadius;
         QPointF edgeOffset1(xSource,ySource);
 
-        qreal xDest = (line.dx() / length) * dest->getRadius();
-        qreal yDest = (line.dy() / length) * dest->getRadius();
+        qreal xDest = (line.dx() / length) * destRadius;
+        qreal yDest = (line.dy() / length) * destRadius;
         QPointF edgeOffset2(xDest,yDest);
-        sourcePoint = line.p1() + edgeOffset1;
-        destPoint = line.p2() - edgeOffset2;
-    } else {
-        sourcePoint = destPoint = line.p1();
+        return QLineF(line.p1() + edgeOffset1, line.p2() - edgeOffset2);
     }
+    return QLineF(line.p1(), line.p1());
 }
 
-QRectF Edge::boundingRect() const
+void Edge::paintBond(QPainter *painter, const QPointF &source, qreal sourceRadius,
+                     const QPointF &dest, qreal destRadius, qreal arrowSize)
 {
-    if (!source || !dest)
-        return QRectF();
+    QLineF line = trimmed(QLineF(source, dest), sourceRadius, destRadius);
+    paintLine(painter, line.p1(), line.p2(), arrowSize);
+}
 
+QRectF Edge::boundingRect() const
+{
     qreal penWidth = 1;
     qreal extra = (penWidth + arrowSize) / 2.0;
 
-    return QRectF(sourcePoint, QSizeF(destPoint.x() - sourcePoint.x(),
-                                      destPoint.y() - sourcePoint.y()))
+    QRectF rect = QRectF(sourcePoint, QSizeF(destPoint.x() - sourcePoint.x(),
+                                             destPoint.y() - sourcePoint.y()))
         .normalized()
         .adjusted(-extra, -extra, extra, extra);
+    if (!wrapShift.isNull())
+        rect |= rect.translated(-wrapShift);
+    return rect;
 }
 
 void Edge::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
-    if (!source || !dest)
+    TRACE_ZONE("Edge::paint");
+    if (wrapShift.isNull()) {
+        paintLine(painter, sourcePoint, destPoint, arrowSize);
         return;
+    }
 
-    QLineF line(sourcePoint, destPoint);
+    // atravessa a borda: a mesma ligacao nas duas imagens, cortada na caixa
+    painter->save();
+    if (scene())
+        painter->setClipRect(scene()->sceneRect());
+    paintLine(painter, sourcePoint, destPoint, arrowSize);
+    paintLine(painter, sourcePoint - wrapShift, destPoint - wrapShift, arrowSize);
+    painter->restore();
+}
+
+void Edge::paintLine(QPainter *painter, const QPointF &from, const QPointF &to,
+                     qreal arrowSize)
+{
+    QLineF line(from, to);
     if (qFuzzyCompare(line.length(), qreal(0.)))
         return;
 
@@ -127,14 +156,14 @@ void Edge::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
     if (line.dy() >= 0)
         angle = TwoPi - angle;
 
-    QPointF sourceArrowP1 = sourcePoint + QPointF(sin(angle + Pi / 3) * arrowSize,
-                                                  cos(angle + Pi / 3) * arrowSize);
-    QPointF sourceArrowP2 = sourcePoint + QPointF(sin(angle + Pi - Pi / 3) * arrowSize,
-                                                  cos(angle + Pi - Pi / 3) * arrowSize);
-    QPointF destArrowP1 = destPoint + QPointF(sin(angle - Pi / 3) * arrowSize,
-                                              cos(angle - Pi / 3) * arrowSize);
-    QPointF destArrowP2 = destPoint + QPointF(sin(angle - Pi + Pi / 3) * arrowSize,
-                                              cos(angle - Pi + Pi / 3) * arrowSize);
+    QPointF sourceArrowP1 = from + QPointF(sin(angle + Pi / 3) * arrowSize,
+                                           cos(angle + Pi / 3) * arrowSize);
+    QPointF sourceArrowP2 = from + QPointF(sin(angle + Pi - Pi / 3) * arrowSize,
+                                           cos(angle + Pi - Pi / 3) * arrowSize);
+    QPointF destArrowP1 = to + QPointF(sin(angle - Pi / 3) * arrowSize,
+                                       cos(angle - Pi / 3) * arrowSize);
+    QPointF destArrowP2 = to + QPointF(sin(angle - Pi + Pi / 3) * arrowSize,
+                                       cos(angle - Pi + Pi / 3) * arrowSize);
 
     painter->setBrush(Qt::black);
     painter->drawPolygon(QPolygonF() << line.p1() << sourceArrowP1 << sourceArrowP2);
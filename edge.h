@@ -42,19 +42,29 @@
 #define EDGE_H
 
 #include <QGraphicsItem>
-
-class Atom;
+#include <QLineF>
 
 //! [0]
+// Desenho de uma ligacao da Simulation. O Edge nao guarda os atomos:
+// a cada quadro a GraphWidget diz qual ligacao ele mostra e chama
+// adjust() com as pontas dela, que podem nem ter item (fora da tela).
+// No modo periodico destShift leva o destino para a imagem mais perto da
+// origem; a ligacao e desenhada dos dois lados da borda.
 class Edge : public QGraphicsItem
 {
 public:
-    Edge(Atom *sourceNode, Atom *destNode);
+    Edge();
 
-    Atom *sourceNode() const;
-    Atom *destNode() const;
+    void setBond(int bond);
+    int bond() const;
+    void adjust(const QPointF &source, qreal sourceRadius,
+                const QPointF &dest, qreal destRadius,
+                const QPointF &destShift = QPointF());
 
-    void adjust();
+    // o desenho da ligacao sem item, para quem pinta fora da cena
+    // (FrameExporter): corta nas bordas dos atomos e poe as setas
+    static void paintBond(QPainter *painter, const QPointF &source, qreal sourceRadius,
+                          const QPointF &dest, qreal destRadius, qreal arrowSize = 1);
 
     enum { Type = UserType + 2 };
     int type() const Q_DECL_OVERRIDE { return Type; }
@@ -64,11 +74,16 @@ protected:
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) Q_DECL_OVERRIDE;
 
 private:
-    Atom *source, *dest;
+    int bondIndex;
 
     QPointF sourcePoint;
     QPointF destPoint;
+    QPointF wrapShift;
     qreal arrowSize;
+
+    static QLineF trimmed(const QLineF &line, qreal sourceRadius, qreal destRadius);
+    static void paintLine(QPainter *painter, const QPointF &from, const QPointF &to,
+                          qreal arrowSize);
 };
 //! [0]
 
@@ -0,0 +1,67 @@
+#include "elements.h"
+
+#include <map>
+
+static const ElementInfo elementTable[] =
+{
+    { 1, 6, 1.008, "H", "#ffffff", "#a0a0a4"},
+    { 8, 11, 15.999, "O", "#ffa040", "#a04000"},
+    { 9, 9, 18.998, "F", "#ff0000", "#800000"},
+    {17, 12, 35.45, "Cl", "#00ff00", "#008000"}
+};
+
+static const int elementCount = sizeof(elementTable) / sizeof(elementTable[0]);
+
+const ElementInfo &elementInfo(int atomicNumber)
+{
+    for(int i = 0; i < elementCount; i++)
+    {
+        if(elementTable[i].atomicNumber == atomicNumber)
+            return elementTable[i];
+    }
+    return elementTable[0];
+}
+
+int elementType(int atomicNumber)
+{
+    for(int i = 0; i < elementCount; i++)
+    {
+        if(elementTable[i].atomicNumber == atomicNumber)
+            return i;
+    }
+    return 0;
+}
+
+int elementTypeCount()
+{
+    return elementCount;
+}
+
+const ElementInfo &elementInfoByType(int type)
+{
+    return elementTable[type];
+}
+
+std::string molecularFormula(const std::vector<int> &atomicNumbers)
+{
+    std::map<std::string, int> symbols;
+    for(size_t i = 0; i < atomicNumbers.size(); i++)
+        symbols[elementInfo(atomicNumbers[i]).symbol]++;
+
+    std::string formula;
+    std::map<std::string, int>::iterator h = symbols.find("H");
+    if(h != symbols.end())
+    {
+        formula += "H";
+        if(h->second > 1)
+            formula += std::to_string(h->second);
+        symbols.erase(h);
+    }
+    for(std::map<std::string, int>::const_iterator s = symbols.begin(); s != symbols.end(); ++s)
+    {
+        formula += s->first;
+        if(s->second > 1)
+            formula += std::to_string(s->second);
+    }
+    return formula;
+}
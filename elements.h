@@ -0,0 +1,30 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <string>
+#include <vector>
+
+// Tabela de elementos compartilhada pela fisica e pelo desenho.
+// Nao depende do Qt para poder ser usada fora da janela.
+struct ElementInfo
+{
+    int atomicNumber;
+    double radius;
+    double mass;
+    const char *symbol;
+    const char *lightColor;
+    const char *darkColor;
+};
+
+const ElementInfo &elementInfo(int atomicNumber);
+
+// O tipo e a posicao do elemento na tabela, para indexar tabelas por par.
+int elementType(int atomicNumber);
+int elementTypeCount();
+const ElementInfo &elementInfoByType(int type);
+
+// Formula de uma molecula pelos numeros atomicos dos atomos dela: H
+// primeiro e o resto em ordem alfabetica ("HCl", "H2O").
+std::string molecularFormula(const std::vector<int> &atomicNumbers);
+
+#endif // ELEMENTS_H
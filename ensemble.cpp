@@ -0,0 +1,155 @@
+#include "ensemble.h"
+#include "simulation.h"
+#include "elements.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QRunnable>
+#include <QStringList>
+#include <QTextStream>
+#include <QThreadPool>
+#include <random>
+
+class RunTask : public QRunnable
+{
+public:
+    RunTask(const RunSpec &spec, RunResult *result)
+        : spec(spec), result(result) {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        *result = EnsembleRunner::runOne(spec);
+    }
+
+private:
+    RunSpec spec;
+    RunResult *result;
+};
+
+// Formula de cada molecula (molecularFormula) e quantas vezes aparece:
+// "Cl:1 HF:1".
+static QString composition(const Simulation &sim)
+{
+    QMap<QString, int> counts;
+    for(int m = 0; m < sim.moleculeCount(); m++)
+    {
+        const std::vector<int> &members = sim.molecule(m).members;
+        if(members.empty())
+            continue;
+
+        std::vector<int> elements(members.size());
+        for(size_t i = 0; i < members.size(); i++)
+            elements[i] = sim.atom(members[i]).element;
+        counts[QString::fromStdString(molecularFormula(elements))]++;
+    }
+
+    QStringList parts;
+    for(QMap<QString, int>::const_iterator it = counts.constBegin(); it != counts.constEnd(); ++it)
+        parts << QString("%1:%2").arg(it.key()).arg(it.value());
+    return parts.join(" ");
+}
+
+EnsembleRunner::EnsembleRunner()
+    : threads(0)
+{
+}
+
+void EnsembleRunner::addRun(const RunSpec &spec)
+{
+    specs.append(spec);
+}
+
+void EnsembleRunner::run()
+{
+    results.resize(specs.size());
+
+    QThreadPool pool;
+    if(threads > 0)
+        pool.setMaxThreadCount(threads);
+    for(int i = 0; i < specs.size(); i++)
+        pool.start(new RunTask(specs[i], &results[i]));
+    pool.waitForDone();
+}
+
+RunResult EnsembleRunner::runOne(const RunSpec &spec)
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    Simulation sim;
+    Scenario scenario = spec.scenario;
+    scenario.seed = spec.seed;
+    sim.loadScenario(scenario);
+
+    if(spec.speedJitter > 0 || spec.spinJitter > 0)
+    {
+        std::mt19937 random(spec.seed);
+        std::uniform_real_distribution<double> speed(-spec.speedJitter, spec.speedJitter);
+        std::uniform_real_distribution<double> spin(-spec.spinJitter, spec.spinJitter);
+        for(int m = 0; m < sim.moleculeCount(); m++)
+        {
+            const SimMolecule &mol = sim.molecule(m);
+            if(mol.members.empty())
+                continue;
+            double vx = mol.vx + speed(random);
+            double vy = mol.vy + speed(random);
+            double angular = mol.angular + (mol.members.size() > 1 ? spin(random) : 0);
+            sim.setMoleculeVelocity(m, vx, vy, angular);
+        }
+    }
+
+    RunResult result;
+    result.reactionStep = -1;
+    int step = 0;
+    for(; step < spec.steps; step++)
+    {
+        sim.step();
+        if(result.reactionStep < 0 && sim.reactions() > 0)
+        {
+            result.reactionStep = step + 1;
+            if(spec.stopOnReaction)
+            {
+                step++;
+                break;
+            }
+        }
+        if(sim.isAtRest())
+        {
+            step++;
+            break;
+        }
+    }
+
+    SimStats stats = sim.stats();
+    result.reactions = stats.reactions;
+    result.steps = step;
+    result.kineticEnergy = stats.kineticEnergy;
+    result.potentialEnergy = stats.potentialEnergy;
+    result.composition = composition(sim);
+    result.atoms = sim.atomCount();
+    result.memoryBytes = stats.memoryBytes;
+    result.milliseconds = clock.elapsed();
+    return result;
+}
+
+bool EnsembleRunner::writeResults(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+    out << "run,seed,reaction_step,reactions,steps,kinetic,potential,total,composition,ms,atoms,bytes\n";
+    for(int i = 0; i < results.size(); i++)
+    {
+        const RunResult &r = results[i];
+        out << i << ',' << specs[i].seed << ',' << r.reactionStep << ','
+            << r.reactions << ',' << r.steps << ','
+            << r.kineticEnergy << ',' << r.potentialEnergy << ','
+            << r.kineticEnergy + r.potentialEnergy << ','
+            << r.composition << ',' << r.milliseconds << ','
+            << r.atoms << ',' << r.memoryBytes << '\n';
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <QString>
+#include <QVector>
+
+#include "simtypes.h"
+
+// Uma simulacao do conjunto: a cena, a semente e quanto rodar.
+struct RunSpec
+{
+    Scenario scenario;
+    unsigned seed;
+    int steps;
+    bool stopOnReaction;
+    double speedJitter; // soma +-jitter as velocidades iniciais de cada molecula
+    double spinJitter;
+
+    RunSpec() : seed(1), steps(3000), stopOnReaction(false), speedJitter(0), spinJitter(0) {}
+};
+
+struct RunResult
+{
+    long long reactionStep; // -1 se nao reagiu
+    int reactions;
+    int steps;
+    double kineticEnergy;
+    double potentialEnergy;
+    QString composition;    // "Cl:1 HF:1"
+    qint64 milliseconds;
+    int atoms;
+    qint64 memoryBytes;     // Simulation::memoryUsage() no fim
+};
+
+// Roda muitas simulacoes independentes, uma por tarefa no QThreadPool,
+// sem janela. Cada tarefa escreve so no seu resultado.
+class EnsembleRunner
+{
+public:
+    EnsembleRunner();
+
+    void setThreads(int count) { threads = count; }
+    void addRun(const RunSpec &spec);
+    void run();
+
+    int runCount() const { return specs.size(); }
+    const RunSpec &spec(int i) const { return specs[i]; }
+    const RunResult &result(int i) const { return results[i]; }
+    bool writeResults(const QString &fileName) const;
+
+    static RunResult runOne(const RunSpec &spec);
+
+private:
+    int threads; // 0 = um por nucleo
+    QVector<RunSpec> specs;
+    QVector<RunResult> results;
+};
+
+#endif // ENSEMBLE_H
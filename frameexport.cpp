@@ -0,0 +1,193 @@
+#include "frameexport.h"
+#include "atom.h"
+#include "edge.h"
+#include "graphwidget.h"
+#include "elements.h"
+#include "trace.h"
+
+#include <QRunnable>
+#include <QPainter>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+class FrameExporter::RenderTask : public QRunnable
+{
+public:
+    RenderTask(FrameExporter *exporter, const SimFrame &frame, int index)
+        : exporter(exporter), frame(frame), index(index) {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        TRACE_THREAD("export");
+        QImage image(exporter->size, QImage::Format_ARGB32_Premultiplied);
+        {
+            TRACE_ZONE("FrameExporter::paint");
+            exporter->paint(frame, image);
+        }
+        {
+            TRACE_ZONE("FrameExporter::write");
+            if(!exporter->write(image, index))
+                exporter->failures++;
+        }
+        exporter->room.release();
+    }
+
+private:
+    FrameExporter *exporter;
+    SimFrame frame;
+    int index;
+};
+
+FrameExporter::FrameExporter()
+    : queueLimit(0), labels(false), width(0), scale(1), raw(false), next(0), failures(0)
+{
+    setThreads(0);
+}
+
+FrameExporter::~FrameExporter()
+{
+    finish();
+}
+
+// 0 = uma por nucleo
+void FrameExporter::setThreads(int count)
+{
+    if(count > 0)
+        pool.setMaxThreadCount(count);
+    int limit = 2 * pool.maxThreadCount();
+    if(limit > queueLimit)
+        room.release(limit - queueLimit);
+    else
+        room.acquire(queueLimit - limit);
+    queueLimit = limit;
+}
+
+bool FrameExporter::begin(const QString &fileName, const SimBox &box)
+{
+    finish();
+    next = 0;
+    failures = 0;
+
+    QFileInfo info(fileName);
+    raw = info.suffix().compare("rgba", Qt::CaseInsensitive) == 0;
+    base = info.dir().filePath(info.completeBaseName());
+    rawName = raw ? info.filePath() : QString();
+    if(!info.dir().exists() && !QDir().mkpath(info.dir().path()))
+        return false;
+    if(raw)
+    {
+        // as tarefas so abrem para escrever no lugar delas
+        QFile file(rawName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+    }
+
+    scale = width > 0 ? width / box.width : 1;
+    size = QSize(qMax(1, qRound(box.width * scale)), qMax(1, qRound(box.height * scale)));
+
+    sprites.resize(elementTypeCount());
+    spriteOrigins.resize(elementTypeCount());
+    for(int type = 0; type < elementTypeCount(); type++)
+    {
+        const ElementInfo &element = elementInfoByType(type);
+        struct atomType atomIn;
+        atomIn.r = element.radius;
+        atomIn.lightColor = element.lightColor;
+        atomIn.darkColor = element.darkColor;
+        atomIn.atomName = element.symbol;
+        sprites[type] = Atom::renderSprite(atomIn, scale, labels, spriteOrigins[type]);
+    }
+    return true;
+}
+
+void FrameExporter::add(const SimFrame &frame)
+{
+    // fila cheia: espera a tarefa mais adiantada acabar
+    room.acquire();
+    pool.start(new RenderTask(this, frame, next++));
+}
+
+bool FrameExporter::finish()
+{
+    pool.waitForDone();
+    return failures.load() == 0;
+}
+
+// Como a janela com zoom: o fundo, os atomos e as ligacoes por cima deles
+// (o Edge tem z maior que o Atom). No modo periodico as ligacoes que
+// atravessam a borda aparecem dos dois lados, cortadas na caixa.
+void FrameExporter::paint(const SimFrame &frame, QImage &image) const
+{
+    const SimBox &box = frame.box;
+    QRectF area(box.left, box.top, box.width, box.height);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scale, scale);
+    painter.translate(-box.left, -box.top);
+    GraphWidget::paintBox(&painter, area, area);
+
+    int n = (int)frame.x.size();
+    std::vector<QPointF> position(n);
+    for(int i = 0; i < n; i++)
+    {
+        double x = frame.x[i];
+        double y = frame.y[i];
+        box.wrap(x, y);
+        position[i] = QPointF(x, y);
+    }
+
+    // o sprite ja esta na escala: so a posicao passa pela transformacao
+    painter.save();
+    painter.resetTransform();
+    for(int i = 0; i < n; i++)
+    {
+        int type = elementType(frame.element[i]);
+        QPointF corner((position[i].x() - box.left) * scale, (position[i].y() - box.top) * scale);
+        painter.drawImage(corner + spriteOrigins[type], sprites[type]);
+    }
+    painter.restore();
+
+    if(box.periodic)
+        painter.setClipRect(area);
+    for(size_t k = 0; k < frame.bondA.size(); k++)
+    {
+        if(!frame.bondVisible[k])
+            continue;
+        int a = frame.bondA[k];
+        int b = frame.bondB[k];
+        qreal radiusA = elementInfo(frame.element[a]).radius;
+        qreal radiusB = elementInfo(frame.element[b]).radius;
+        QPointF shift;
+        if(box.periodic)
+        {
+            double dx = frame.x[b] - frame.x[a];
+            double dy = frame.y[b] - frame.y[a];
+            box.minimumImage(dx, dy);
+            shift = position[a] + QPointF(dx, dy) - position[b];
+            if(shift.manhattanLength() < 1e-6)
+                shift = QPointF();
+        }
+        Edge::paintBond(&painter, position[a], radiusA, position[b] + shift, radiusB);
+        if(!shift.isNull())
+            Edge::paintBond(&painter, position[a] - shift, radiusA, position[b], radiusB);
+    }
+}
+
+bool FrameExporter::write(const QImage &image, int index) const
+{
+    if(!raw)
+        return image.save(QString("%1-%2.png").arg(base).arg(index, 5, 10, QChar('0')), "PNG");
+
+    // cada tarefa abre o seu: escreve so no pedaco do seu quadro
+    QImage pixels = image.convertToFormat(QImage::Format_RGBA8888);
+    QFile file(rawName);
+    if(!file.open(QIODevice::ReadWrite))
+        return false;
+    qint64 bytes = (qint64)pixels.bytesPerLine() * pixels.height();
+    if(!file.seek(bytes * index))
+        return false;
+    return file.write((const char *)pixels.constBits(), bytes) == bytes;
+}
@@ -0,0 +1,76 @@
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include <QString>
+#include <QSize>
+#include <QImage>
+#include <QPointF>
+#include <QVector>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <atomic>
+
+#include "simtypes.h"
+
+// Grava uma sequencia de quadros como imagens, para montar video sem
+// gravar a tela. Cada quadro vira uma tarefa no QThreadPool que pinta
+// numa QImage so dela e grava; add() copia o quadro e volta, e so espera
+// quando ja ha dois quadros por thread na fila.
+//
+// O nome do arquivo decide o formato:
+//   aula.png  -> aula-00000.png, aula-00001.png, ...
+//   aula.rgba -> um arquivo so, os pixels crus (RGBA, 8 bits) quadro
+//                apos quadro, na ordem, mesmo gravados fora de ordem:
+//                ffmpeg -f rawvideo -pix_fmt rgba -s LxA -r 25 -i aula.rgba
+//
+// O desenho e o da janela (Atom::renderSprite, Edge::paintBond e
+// GraphWidget::paintBox), com a caixa inteira na imagem e os atomos
+// escalados junto com ela. Os sprites sao feitos uma vez no begin() e
+// depois so lidos pelas tarefas.
+class FrameExporter
+{
+public:
+    FrameExporter();
+    ~FrameExporter();
+
+    void setThreads(int count);
+    void setLabels(bool on) { labels = on; }
+    // largura da imagem; a altura segue a caixa. 0 = um pixel por unidade
+    void setWidth(int pixels) { width = pixels; }
+
+    bool begin(const QString &fileName, const SimBox &box);
+    void add(const SimFrame &frame);
+    // espera as tarefas; false se algum quadro nao foi gravado
+    bool finish();
+
+    int frameCount() const { return next; }
+    QSize imageSize() const { return size; }
+    bool isRaw() const { return raw; }
+
+private:
+    class RenderTask;
+
+    QThreadPool pool;
+    QSemaphore room;
+    int queueLimit;
+
+    bool labels;
+    int width;
+    QSize size;
+    double scale;
+    bool raw;
+    QString base;   // sem a extensao, para os .png
+    QString rawName;
+
+    // por tipo de elemento (elementType)
+    QVector<QImage> sprites;
+    QVector<QPointF> spriteOrigins;
+
+    int next;
+    std::atomic<int> failures;
+
+    void paint(const SimFrame &frame, QImage &image) const;
+    bool write(const QImage &image, int index) const;
+};
+
+#endif // FRAMEEXPORT_H
@@ -0,0 +1,112 @@
+#include "framehistory.h"
+
+#include <algorithm>
+#include <utility>
+
+FrameHistory::FrameHistory(size_t maxBytes, int keyInterval)
+    : bytes(0), maxBytes(maxBytes), keyInterval(keyInterval), sinceKey(0), keys(0)
+{
+}
+
+void FrameHistory::clear()
+{
+    entries.clear();
+    encoder = SnapshotEncoder();
+    bytes = 0;
+    sinceKey = 0;
+    keys = 0;
+}
+
+void FrameHistory::record(const SimFrame &frame)
+{
+    // o passo nao andou (um comando sem passo, por exemplo): nada novo
+    if(!entries.empty() && frame.step <= entries.back().step)
+        return;
+
+    Entry entry;
+    entry.step = frame.step;
+    entry.reactions = frame.stats.reactions;
+    entry.key = encoder.encode(frame, scratch);
+    if(!entry.key && ++sinceKey >= keyInterval)
+    {
+        // mesmo estado, agora inteiro: o delta ja atualizou o encoder
+        encoder.encodeKey(scratch);
+        entry.key = true;
+    }
+    if(entry.key)
+    {
+        sinceKey = 0;
+        keys++;
+    }
+    // copia do tamanho exato: o scratch fica com a capacidade do maior
+    entry.message.assign(scratch.begin(), scratch.end());
+    bytes += entry.message.capacity() + sizeof(Entry);
+    entries.push_back(std::move(entry));
+
+    // sempre sobra pelo menos o ultimo quadro completo e os seus deltas
+    while(bytes > maxBytes && keys > 1)
+        dropOldest();
+}
+
+void FrameHistory::dropOldest()
+{
+    // o mais antigo e sempre um quadro completo; os deltas depois dele
+    // dependem dele e saem juntos
+    do
+    {
+        if(entries.front().key)
+            keys--;
+        bytes -= entries.front().message.capacity() + sizeof(Entry);
+        entries.pop_front();
+    }
+    while(!entries.empty() && !entries.front().key);
+}
+
+unsigned long long FrameHistory::firstStep() const
+{
+    return entries.empty() ? 0 : entries.front().step;
+}
+
+unsigned long long FrameHistory::lastStep() const
+{
+    return entries.empty() ? 0 : entries.back().step;
+}
+
+bool FrameHistory::seek(unsigned long long step, SimFrame &frame) const
+{
+    if(entries.empty() || step < entries.front().step)
+        return false;
+
+    // o ultimo com entry.step <= step
+    struct After
+    {
+        bool operator()(unsigned long long s, const Entry &e) const { return s < e.step; }
+    };
+    size_t target = std::upper_bound(entries.begin(), entries.end(), step, After())
+            - entries.begin() - 1;
+    size_t first = target;
+    while(!entries[first].key)
+        first--;
+
+    SnapshotDecoder decoder;
+    for(size_t i = first; i <= target; i++)
+    {
+        const std::vector<uint8_t> &message = entries[i].message;
+        if(!decoder.decode(message.data(), message.size(), frame))
+            return false;
+    }
+    return true;
+}
+
+bool FrameHistory::lastReactionStep(unsigned long long &step) const
+{
+    for(size_t i = entries.size(); i > 1; i--)
+    {
+        if(entries[i - 1].reactions > entries[i - 2].reactions)
+        {
+            step = entries[i - 1].step;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+#ifndef FRAMEHISTORY_H
+#define FRAMEHISTORY_H
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include "simtypes.h"
+#include "snapshotcodec.h"
+
+// Os ultimos passos, para voltar e ver de novo (a reacao, por exemplo)
+// sem simular outra vez. Cada passo vira uma mensagem do SnapshotEncoder:
+// um quadro completo a cada keyInterval passos e deltas entre eles. O
+// total fica abaixo de maxBytes: os passos mais antigos saem primeiro, e
+// os deltas que ficaram sem o quadro completo de antes saem junto.
+//
+// seek() decodifica o quadro completo anterior e os deltas ate o passo
+// pedido, entao custa no maximo keyInterval deltas. As posicoes voltam
+// quantizadas como no socket (1/16 de unidade).
+class FrameHistory
+{
+public:
+    explicit FrameHistory(size_t maxBytes = 64 << 20, int keyInterval = 50);
+
+    void record(const SimFrame &frame);
+    void clear();
+
+    bool empty() const { return entries.empty(); }
+    unsigned long long firstStep() const;
+    unsigned long long lastStep() const;
+    // o passo gravado mais perto de step, sem passar dele
+    bool seek(unsigned long long step, SimFrame &frame) const;
+    // todos os passos gravados, em ordem, com um SnapshotDecoder so: cada
+    // delta e decodificado uma vez, e nao ate keyInterval vezes como com
+    // um seek() por passo. visit(frame) recebe cada um; false se alguma
+    // mensagem nao decodificar
+    template<class Visitor>
+    bool replay(Visitor visit) const
+    {
+        SnapshotDecoder decoder;
+        SimFrame frame;
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            const std::vector<uint8_t> &message = entries[i].message;
+            if(!decoder.decode(message.data(), message.size(), frame))
+                return false;
+            visit(frame);
+        }
+        return true;
+    }
+    // o ultimo passo gravado em que houve reacao; false se nenhum
+    bool lastReactionStep(unsigned long long &step) const;
+
+    size_t memoryUsage() const { return bytes; }
+    size_t memoryLimit() const { return maxBytes; }
+    int keyCount() const { return keys; }
+    int stepCount() const { return (int)entries.size(); }
+
+private:
+    struct Entry
+    {
+        unsigned long long step;
+        int reactions;
+        bool key;
+        std::vector<uint8_t> message;
+    };
+
+    std::deque<Entry> entries;
+    SnapshotEncoder encoder;
+    std::vector<uint8_t> scratch;
+    size_t bytes;
+    size_t maxBytes;
+    int keyInterval;
+    int sinceKey;
+    int keys;
+
+    void dropOldest();
+};
+
+#endif // FRAMEHISTORY_H
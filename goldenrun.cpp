@@ -0,0 +1,236 @@
+#include "goldenrun.h"
+#include "simulation.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QStringList>
+#include <QTextStream>
+
+GoldenRun::GoldenRun()
+    : microseconds(0), repeats(1)
+{
+}
+
+bool GoldenRun::run(const GoldenSpec &spec)
+{
+    runSpec = spec;
+    runSpec.every = qMax(1, spec.every);
+
+    bool same = true;
+    qint64 best = 0;
+    for(int r = 0; r < repeats; r++)
+    {
+        QVector<GoldenSample> again;
+        qint64 nanoseconds;
+        runOnce(again, nanoseconds);
+        if(r == 0)
+        {
+            results = again;
+            best = nanoseconds;
+            continue;
+        }
+        best = qMin(best, nanoseconds);
+        if(again.size() != results.size())
+        {
+            same = false;
+            continue;
+        }
+        for(int i = 0; i < again.size(); i++)
+        {
+            if(again[i].checksum != results[i].checksum)
+                same = false;
+        }
+    }
+    microseconds = runSpec.steps > 0 ? best / 1000.0 / runSpec.steps : 0;
+    return same;
+}
+
+// O checksum fica fora do tempo: so os passos contam.
+void GoldenRun::runOnce(QVector<GoldenSample> &out, qint64 &nanoseconds) const
+{
+    Simulation sim;
+    sim.loadScenario(runSpec.scenario);
+    if(runSpec.flexible)
+        sim.setFlexible(true);
+    if(runSpec.periodic)
+        sim.setPeriodic(true);
+
+    out.clear();
+    out.reserve(runSpec.steps / runSpec.every + 1);
+    GoldenSample sample;
+    sample.step = 0;
+    sample.checksum = sim.checksum();
+    sample.reactions = sim.reactions();
+    out.append(sample);
+
+    QElapsedTimer clock;
+    nanoseconds = 0;
+    for(int step = 1; step <= runSpec.steps; step++)
+    {
+        clock.start();
+        sim.step();
+        nanoseconds += clock.nsecsElapsed();
+        if(step % runSpec.every != 0)
+            continue;
+        sample.step = step;
+        sample.checksum = sim.checksum();
+        sample.reactions = sim.reactions();
+        out.append(sample);
+    }
+}
+
+bool GoldenRun::write(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    const Scenario &scenario = runSpec.scenario;
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+    out << "world=" << scenario.worldSize
+        << " pairs=" << scenario.extraPairs
+        << " seed=" << scenario.seed
+        << " encounter=" << (scenario.encounter ? 1 : 0)
+        << " speed=" << scenario.approachSpeed
+        << " angle=" << scenario.approachAngle
+        << " spin=" << scenario.approachSpin
+        << " custom_reaction=" << (scenario.customReaction ? 1 : 0)
+        << " reaction_distance=" << scenario.reactionDistance
+        << " ph=" << scenario.solutionPH
+        << " thermostat=" << scenario.thermostat
+        << " temperature=" << scenario.targetTemperature
+        << " flexible=" << (runSpec.flexible ? 1 : 0)
+        << " periodic=" << (runSpec.periodic ? 1 : 0)
+        << " steps=" << runSpec.steps
+        << " every=" << runSpec.every
+        << " us_per_step=" << microseconds << '\n';
+    out << "step,checksum,reactions\n";
+    for(int i = 0; i < results.size(); i++)
+    {
+        const GoldenSample &sample = results[i];
+        out << sample.step << ','
+            << QString("%1").arg((qulonglong)sample.checksum, 16, 16, QChar('0')) << ','
+            << sample.reactions << '\n';
+    }
+    return true;
+}
+
+// Le e tira do mapa a chave, se estiver la; ok vira false se o valor nao
+// for numero. O que sobrar no mapa no fim e chave desconhecida.
+static void readValue(QMap<QString, QString> &values, const char *key, double &target, bool &ok)
+{
+    if(!values.contains(key))
+        return;
+    bool parsed;
+    double value = values.take(key).toDouble(&parsed);
+    if(parsed)
+        target = value;
+    ok = ok && parsed;
+}
+
+static void readValue(QMap<QString, QString> &values, const char *key, int &target, bool &ok)
+{
+    if(!values.contains(key))
+        return;
+    bool parsed;
+    int value = values.take(key).toInt(&parsed);
+    if(parsed)
+        target = value;
+    ok = ok && parsed;
+}
+
+static void readValue(QMap<QString, QString> &values, const char *key, unsigned &target, bool &ok)
+{
+    if(!values.contains(key))
+        return;
+    bool parsed;
+    unsigned value = values.take(key).toUInt(&parsed);
+    if(parsed)
+        target = value;
+    ok = ok && parsed;
+}
+
+static void readValue(QMap<QString, QString> &values, const char *key, bool &target, bool &ok)
+{
+    int value = target ? 1 : 0;
+    readValue(values, key, value, ok);
+    target = value != 0;
+}
+
+bool GoldenRun::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    QTextStream in(&file);
+    QMap<QString, QString> values;
+    foreach(const QString &pair, in.readLine().split(' ', QString::SkipEmptyParts))
+    {
+        int equals = pair.indexOf('=');
+        if(equals <= 0)
+            return false;
+        values.insert(pair.left(equals), pair.mid(equals + 1));
+    }
+    if(!values.contains("steps") || !values.contains("us_per_step"))
+        return false;
+
+    // o que faltar fica com o padrao; o que sobrar e erro
+    runSpec = GoldenSpec();
+    Scenario &scenario = runSpec.scenario;
+    bool ok = true;
+    readValue(values, "world", scenario.worldSize, ok);
+    readValue(values, "pairs", scenario.extraPairs, ok);
+    readValue(values, "seed", scenario.seed, ok);
+    readValue(values, "encounter", scenario.encounter, ok);
+    readValue(values, "speed", scenario.approachSpeed, ok);
+    readValue(values, "angle", scenario.approachAngle, ok);
+    readValue(values, "spin", scenario.approachSpin, ok);
+    readValue(values, "custom_reaction", scenario.customReaction, ok);
+    readValue(values, "reaction_distance", scenario.reactionDistance, ok);
+    readValue(values, "ph", scenario.solutionPH, ok);
+    readValue(values, "thermostat", scenario.thermostat, ok);
+    readValue(values, "temperature", scenario.targetTemperature, ok);
+    readValue(values, "flexible", runSpec.flexible, ok);
+    readValue(values, "periodic", runSpec.periodic, ok);
+    readValue(values, "steps", runSpec.steps, ok);
+    readValue(values, "every", runSpec.every, ok);
+    readValue(values, "us_per_step", microseconds, ok);
+    if(!ok || !values.isEmpty())
+        return false;
+    runSpec.every = qMax(1, runSpec.every);
+
+    in.readLine(); // cabecalho da tabela
+    results.clear();
+    while(!in.atEnd())
+    {
+        QStringList fields = in.readLine().split(',');
+        if(fields.size() < 3)
+            continue;
+        GoldenSample sample;
+        sample.step = fields[0].toULongLong();
+        sample.checksum = fields[1].toULongLong(&ok, 16);
+        sample.reactions = fields[2].toInt();
+        if(!ok)
+            return false;
+        results.append(sample);
+    }
+    return true;
+}
+
+long long GoldenRun::firstDivergence(const GoldenRun &baseline) const
+{
+    const QVector<GoldenSample> &other = baseline.results;
+    int common = qMin(results.size(), other.size());
+    for(int i = 0; i < common; i++)
+    {
+        if(results[i].step != other[i].step || results[i].checksum != other[i].checksum)
+            return (long long)other[i].step;
+    }
+    if(results.size() == other.size())
+        return -1;
+    // uma acabou antes: diverge no primeiro passo que so a outra tem
+    return (long long)(common < other.size() ? other[common].step : results[common].step);
+}
@@ -0,0 +1,71 @@
+#ifndef GOLDENRUN_H
+#define GOLDENRUN_H
+
+#include <QString>
+#include <QVector>
+#include <stdint.h>
+
+#include "simtypes.h"
+
+// A cena de uma corrida de referencia. Tudo que sorteia usa a semente do
+// Scenario, entao a mesma especificacao da sempre os mesmos passos.
+struct GoldenSpec
+{
+    Scenario scenario;
+    bool flexible;
+    bool periodic;  // fora do Scenario: e o setPeriodic depois de montar
+    int steps;
+    int every;      // um checksum a cada tantos passos
+
+    GoldenSpec() : flexible(false), periodic(false), steps(2000), every(1) {}
+};
+
+struct GoldenSample
+{
+    unsigned long long step;
+    uint64_t checksum;  // Simulation::checksum()
+    int reactions;
+};
+
+// Roda uma GoldenSpec sem janela guardando o checksum do estado e o
+// tempo dos passos, e compara com uma referencia gravada antes. Serve de
+// trava para otimizacoes: o resultado tem que ser o mesmo bit a bit e o
+// tempo nao pode piorar alem do limite.
+//
+// O tempo e so o de Simulation::step(), a melhor de `repeats` corridas;
+// as corridas repetidas tambem tem que dar os mesmos checksums, senao
+// a simulacao nao e deterministica e run() devolve false.
+//
+// O arquivo e texto: uma linha com a especificacao inteira e o tempo
+// (chave=valor) e depois step,checksum,reactions. read() recusa chave que
+// nao conhece ou valor que nao le: uma referencia de outra versao nao
+// pode virar outra cena sem ninguem ver.
+class GoldenRun
+{
+public:
+    GoldenRun();
+
+    void setRepeats(int count) { repeats = qMax(1, count); }
+    bool run(const GoldenSpec &spec);
+
+    const GoldenSpec &spec() const { return runSpec; }
+    const QVector<GoldenSample> &samples() const { return results; }
+    double stepMicroseconds() const { return microseconds; }
+
+    bool write(const QString &fileName) const;
+    bool read(const QString &fileName);
+
+    // o primeiro passo em que os checksums diferem da referencia; -1 se
+    // nenhum
+    long long firstDivergence(const GoldenRun &baseline) const;
+
+private:
+    GoldenSpec runSpec;
+    QVector<GoldenSample> results;
+    double microseconds;    // por passo
+    int repeats;
+
+    void runOnce(QVector<GoldenSample> &out, qint64 &nanoseconds) const;
+};
+
+#endif // GOLDENRUN_H
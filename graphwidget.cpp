@@ -42,163 +42,207 @@
 #include "edge.h"
 #include "atom.h"
 #include "atomstruct.h"
+#include "elements.h"
+#include "simulation.h"
+#include "simulationthread.h"
+#include "trace.h"
+#include "startupclock.h"
+#include "statestream.h"
+#include "analysisthread.h"
+#include "frameexport.h"
+#include "thermostat.h"
 
 #include <math.h>
+#include <limits.h>
 
 #include <QKeyEvent>
+#include <QApplication>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <QStringList>
 #include <vector>
 
-GraphWidget::GraphWidget(QWidget *parent)
-    : QGraphicsView(parent), timerId(0)
+GraphWidget::GraphWidget(const Scenario &scenario, QWidget *parent)
+    : QGraphicsView(parent), timerId(0), timerInterval(0), simThread(0), viewer(0),
+      currentFrame(0), atomsShown(0), edgesShown(0),
+      flexible(false), periodic(false), sleeping(true),
+      replaying(false), replayPlaying(false), replayStep(0), replayExportWidth(0),
+      showStats(false), analysis(0), showObservables(false)
+{
+    // so a caixa padrao: o cenario e montado na thread da simulacao e a
+    // caixa certa chega com o primeiro quadro
+    Simulation *simulation = new Simulation;
+    setupView(QRectF(simulation->boxLeft(), simulation->boxTop(),
+                     simulation->boxWidth(), simulation->boxHeight()));
+    setWindowTitle(tr("Cooking Meth"));
+    StartupClock::mark("montar a cena");
+
+    simThread = new SimulationThread(simulation, scenario, this);
+    simThread->start();
+    itemMoved();
+    StartupClock::mark("iniciar a thread");
+}
+
+GraphWidget::GraphWidget(const QString &serverName, QWidget *parent)
+    : QGraphicsView(parent), timerId(0), timerInterval(0), simThread(0), viewer(0),
+      currentFrame(0), atomsShown(0), edgesShown(0),
+      flexible(false), periodic(false), sleeping(true),
+      replaying(false), replayPlaying(false), replayStep(0), replayExportWidth(0),
+      showStats(false), analysis(0), showObservables(false)
+{
+    // a caixa vem no primeiro quadro do servidor
+    setupView(QRectF());
+    setWindowTitle(tr("Cooking Meth (%1)").arg(serverName));
+    StartupClock::mark("montar a cena");
+
+    // sem timer: cada leitura do socket que completa um quadro desenha
+    viewer = new StateClient(this);
+    connect(viewer, SIGNAL(frameReady()), this, SLOT(clientFrame()));
+    viewer->connectToServer(serverName);
+}
+
+void GraphWidget::setupView(const QRectF &box)
 {
-    _M_Pi = 3.141592653589;
     QGraphicsScene *scene = new QGraphicsScene(this);
     scene->setItemIndexMethod(QGraphicsScene::NoIndex);
-    scene->setSceneRect(-250, -250, 490, 490);
+    if(!box.isNull())
+        scene->setSceneRect(box);
     setScene(scene);
     setCacheMode(CacheBackground);
     setViewportUpdateMode(BoundingRectViewportUpdate);
     setRenderHint(QPainter::Antialiasing);
     setTransformationAnchor(AnchorUnderMouse);
-    setWindowTitle(tr("Cooking Meth"));
-
-    showLabel = true;
-    atomType1 = defineAtom(1);
-    atomType2 = defineAtom(9);
-    atomType3 = defineAtom(17);
-
-    // mol1 - Quando o grupo e criado ele fica no zero zero.
-    atom4 = new Atom(this,atomType1);
-    atom5 = new Atom(this,atomType3);
-    atom6 = new Atom(this,atomType2);
-    atom4->setPos(-25, 0);
-    atom5->setPos(25, 0);
-    atom6->setPos(0,0);
-    bond4to5 = new Edge(atom4,atom5);
-    scene->addItem(atom4);
-    scene->addItem(atom5);
-    scene->addItem(bond4to5);
-    scene->addItem(atom6);
-
-    //bond 46
-    bond4to6 = new Edge(atom4,atom6);
-    scene->addItem(bond4to6);
-    bond4to6->hide();
-
-    QList<QGraphicsItem *> mol5;
-    mol5 << atom4 << atom5 << bond4to5;
-    mol1 = scene->createItemGroup(mol5);
-    QList<QGraphicsItem *> mol6;
-    mol6 << atom6;
-    mol2 = scene->createItemGroup(mol6);
-
-    mol1->setPos(-125,0);
-    mol1Angle = 0;
-    mol2->setPos(100,-100);
-
-    mol1Vx = 0.1;
-    mol1Vy = 3;
-    mol1Angular = 3;
-
-    mol2Vx = 1;
-    mol2Vy = 2;
-    mol2Angular = 0;
+    setDragMode(ScrollHandDrag);
+    TRACE_THREAD("gui");
+}
 
-    reaction = true;
+GraphWidget::~GraphWidget()
+{
+    if(simThread)
+        simThread->stop();
+    if(analysis)
+        analysis->stop();
+}
 
+// Com exportFile as medidas tambem vao para o arquivo, uma linha por
+// segundo. Chamar de novo nao faz nada.
+void GraphWidget::startAnalysis(const QString &exportFile)
+{
+    if(analysis)
+        return;
+    analysis = new AnalysisThread(this);
+    analysis->setExport(exportFile);
+    analysis->start();
+    if(simThread)
+        simThread->setAnalysis(analysis);
 }
 
-void GraphWidget::itemMoved()
+// Para onde vai o X do replay; sem isso, replay.png na pasta atual.
+void GraphWidget::setReplayExport(const QString &fileName, int width)
 {
-    if (!timerId)
-        timerId = startTimer(1000 / 25);
+    replayExportFile = fileName;
+    replayExportWidth = width;
 }
 
-void GraphWidget::showHideLabels()
+void GraphWidget::clientFrame()
 {
-    if(showLabel)
-        showLabel = false;
-    else
-        showLabel = true;
+    if(analysis)
+        analysis->offer(viewer->frame());
+    // escondida: o viewer continua decodificando, so nao desenha
+    if(isVisible())
+        applyFrame(viewer->frame());
+}
 
-    foreach (QGraphicsItem *item, mol1->childItems()) {
-        if (Atom *atom = qgraphicsitem_cast<Atom *>(item))
-            atom->showHideLabels(showLabel);
-    }
-    foreach (QGraphicsItem *item, mol2->childItems()) {
-        if (Atom *atom = qgraphicsitem_cast<Atom *>(item))
-            atom->showHideLabels(showLabel);
+void GraphWidget::itemMoved()
+{
+    if (!timerId && simThread && !replaying && isVisible()) {
+        timerInterval = frameInterval();
+        timerId = startTimer(timerInterval);
     }
 }
 
-bool GraphWidget::checkIfMoleculeBounced(QGraphicsItemGroup *mol, qreal& Vx, qreal& Vy)
+// O ritmo e so o da SimulationThread: um quadro novo a cada passo, e o
+// passo nunca sai mais rapido que 25 por segundo (a velocidade da cena
+// depende disso). Como qualquer tela atualiza mais rapido, nao ha o que
+// perguntar para ela.
+int GraphWidget::frameInterval() const
 {
-    QList<Atom *> molAtoms;
-    foreach (QGraphicsItem *item, mol->childItems()) {
-        if (Atom *atom = qgraphicsitem_cast<Atom *>(item))
-            molAtoms << atom;
-    }
-    bool bounced = false;
-    int bounceType;
-    qreal angle = mol->rotation() * _M_Pi/180;
-    qreal newx, newy, vecx, vecy;
+    return simThread->framePeriod();
+}
 
-    for(int i = 0; i < molAtoms.size(); i++ )
-    {
-        vecx = molAtoms[i]->x();
-        vecy = molAtoms[i]->y();
-        newx = vecx * cos(angle) - vecy * sin(angle);
-        newy = vecx * sin(angle) + vecy * cos(angle);
-        molAtoms[i]->setAtomPosition(QPointF(mol->pos().x() + newx, mol->pos().y() + newy));
-
-        bounceType = molAtoms[i]->checkBounce();
-        if(bounceType > 0)
-        {
-            bounced = true;
-            break;
-        }
-    }
-    if(!bounced)
-        return bounced;
+void GraphWidget::showHideLabels()
+{
+    Atom::setLabelsVisible(!Atom::labelsVisible());
+    scene()->update();
+}
 
-    switch(bounceType)
-    {
-    case 1:
-        Vx *= -1.0;
-        break;
-    case 2:
-        Vy *= -1.0;
-        break;
-    case 3:
-        Vx *= -1.0;
-        Vy *= -1.0;
-        break;
-    }
+void GraphWidget::pushCommand(qreal dvx, qreal dvy, qreal dAngular)
+{
+    SimCommand command;
+    command.kind = SimCommand::Push;
+    command.atom = 0; // a molecula do primeiro atomo e a do jogador
+    command.flag = false;
+    command.dvx = dvx;
+    command.dvy = dvy;
+    command.dAngular = dAngular;
+    if(simThread && simThread->postCommand(command))
+        itemMoved();
+}
 
-    return bounced;
+// V: molas (vibracao) no lugar do corpo rigido
+// P: caixa periodica no lugar das paredes
+// Z: liga/desliga o sono das moleculas paradas
+void GraphWidget::postMode(int kind, bool on)
+{
+    SimCommand command;
+    command.kind = kind;
+    command.atom = -1;
+    command.flag = on;
+    command.dvx = command.dvy = command.dAngular = 0;
+    if(!simThread || !simThread->postCommand(command))
+        return;
+    itemMoved();
+
+    if(kind == SimCommand::SetFlexible)
+        flexible = on;
+    else if(kind == SimCommand::SetPeriodic)
+        periodic = on;
+    else if(kind == SimCommand::SetSleep)
+        sleeping = on;
 }
 
 void GraphWidget::keyPressEvent(QKeyEvent *event)
 {
+    if(replaying && replayKey(event->key()))
+        return;
+
     switch (event->key()) {
     case Qt::Key_Up:
-        mol1Vy -= 1;
+        pushCommand(0, -1, 0);
         break;
     case Qt::Key_Down:
-        mol1Vy += 1;
+        pushCommand(0, 1, 0);
         break;
     case Qt::Key_Left:
-        mol1Vx -= 1;
+        pushCommand(-1, 0, 0);
         break;
     case Qt::Key_Right:
-        mol1Vx += 1;
+        pushCommand(1, 0, 0);
         break;
     case Qt::Key_Q:
-        mol1Angular += 1;
+        pushCommand(0, 0, 1);
         break;
     case Qt::Key_W:
-        mol1Angular -= 1;
+        pushCommand(0, 0, -1);
+        break;
+    case Qt::Key_V:
+        postMode(SimCommand::SetFlexible, !flexible);
+        break;
+    case Qt::Key_P:
+        postMode(SimCommand::SetPeriodic, !periodic);
+        break;
+    case Qt::Key_Z:
+        postMode(SimCommand::SetSleep, !sleeping);
         break;
 
     case Qt::Key_Plus:
@@ -210,6 +254,45 @@ void GraphWidget::keyPressEvent(QKeyEvent *event)
     case Qt::Key_L:
         showHideLabels();
         break;
+    case Qt::Key_S:
+        showStats = !showStats;
+        viewport()->update();
+        break;
+    case Qt::Key_M:
+        showObservables = !showObservables;
+        if(showObservables)
+            startAnalysis();
+        viewport()->update();
+        break;
+    case Qt::Key_R:
+        setReplay(true);
+        break;
+    case Qt::Key_A:
+        postTitrate(true);
+        break;
+    case Qt::Key_O:
+        postTitrate(false);
+        break;
+    // o termostato atual vem do ultimo quadro: sem quadro, nada a mudar
+    case Qt::Key_K:
+        if(currentFrame)
+            postThermostat((lastStats.thermostat + 1) % Thermostat::KindCount,
+                           lastStats.targetTemperature);
+        break;
+    case Qt::Key_BracketLeft:
+        if(currentFrame)
+            postThermostat(lastStats.thermostat, lastStats.targetTemperature / 1.1);
+        break;
+    case Qt::Key_BracketRight:
+        if(currentFrame)
+            postThermostat(lastStats.thermostat, lastStats.targetTemperature * 1.1);
+        break;
+#ifdef COOKINGMETH_TRACE
+    case Qt::Key_T:
+        if(Trace::writeChromeJson("trace.json"))
+            qDebug() << "trace gravado em trace.json";
+        break;
+#endif
 
     case Qt::Key_Space:
     case Qt::Key_Enter:
@@ -221,115 +304,382 @@ void GraphWidget::keyPressEvent(QKeyEvent *event)
 
 void GraphWidget::timerEvent(QTimerEvent *event)
 {
+    TRACE_ZONE("timerEvent");
     Q_UNUSED(event);
 
-    if(checkIfMoleculeBounced(mol1,mol1Vx,mol1Vy))
-        mol1Angular *= -1;
-    mol1->moveBy(mol1Vx,mol1Vy);
-    mol1Angle += mol1Angular;
-    mol1->setRotation(mol1Angle);
-    if(checkIfMoleculeBounced(mol1,mol1Vx,mol1Vy))
-        mol1->moveBy(mol1Vx,mol1Vy);
+    if(replaying) {
+        if(replayPlaying)
+            seekReplay(replayStep + 1);
+        return;
+    }
+
+    // lido antes do quadro: se a thread ja parou, o quadro dela e o ultimo
+    bool idle = simThread->isIdle();
+
+    // pega o ultimo passo publicado, se houver um novo
+    if(const SimFrame *frame = simThread->takeFrame())
+        applyFrame(*frame);
+
+    if(idle) {
+        killTimer(timerId);
+        timerId = 0;
+        return;
+    }
+
+    int interval = frameInterval();
+    if(qAbs(interval - timerInterval) > 2) {
+        killTimer(timerId);
+        timerInterval = interval;
+        timerId = startTimer(timerInterval);
+    }
+}
+
+// A: acido, O: base. So faz diferenca com a solucao ligada (--ph); cada
+// tecla poe 1e-5 mol/L, o bastante para levar pH 7 a 5 ou 9.
+void GraphWidget::postTitrate(bool acid)
+{
+    SimCommand command;
+    command.kind = SimCommand::Titrate;
+    command.atom = -1;
+    command.flag = acid;
+    command.dvx = 1e-5;
+    command.dvy = command.dAngular = 0;
+    if(simThread && simThread->postCommand(command))
+        itemMoved();
+}
+
+// K troca o termostato (nenhum, Berendsen, rescale, Langevin) e [ ]
+// baixam e sobem o alvo 10%. O alvo comeca na temperatura da cena.
+void GraphWidget::postThermostat(int kind, double target)
+{
+    SimCommand command;
+    command.kind = SimCommand::SetThermostat;
+    command.atom = kind;
+    command.flag = false;
+    command.dvx = target;
+    command.dvy = command.dAngular = 0;
+    if(simThread && simThread->postCommand(command))
+        itemMoved();
+}
+
+// R entra e sai do replay. Dentro dele:
+//   esquerda/direita  um passo
+//   baixo/cima        25 passos
+//   Home/End          o primeiro e o ultimo passo guardados
+//   B                 um pouco antes da ultima reacao
+//   espaco            toca/para
+//   X                 grava todos os passos guardados como quadros
+// Ao sair a fisica continua de onde estava, nao do passo visto.
+void GraphWidget::setReplay(bool on)
+{
+    if(!simThread || on == replaying)
+        return;
+
+    replaying = on;
+    replayPlaying = false;
+    if(timerId) {
+        killTimer(timerId);
+        timerId = 0;
+    }
+    simThread->setPaused(on);
+
+    if(on)
+    {
+        unsigned long long first, last;
+        simThread->historyRange(first, last);
+        seekReplay(last);
+    }
+    else
+    {
+        applyFrame(simThread->latestFrame());
+        itemMoved();
+    }
+    viewport()->update();
+}
+
+void GraphWidget::seekReplay(long long step)
+{
+    unsigned long long first, last;
+    simThread->historyRange(first, last);
+    if(step < (long long)first)
+        step = first;
+    if(step >= (long long)last)
+    {
+        step = last;
+        // chegou ao fim: para de tocar
+        if(replayPlaying && timerId) {
+            killTimer(timerId);
+            timerId = 0;
+        }
+        replayPlaying = false;
+    }
+
+    if(!simThread->seekHistory(step, replayFrame))
+        return;
+    replayStep = replayFrame.step;
+    applyFrame(replayFrame);
+    viewport()->update();
+}
+
+bool GraphWidget::replayKey(int key)
+{
+    switch (key) {
+    case Qt::Key_R:
+        setReplay(false);
+        break;
+    case Qt::Key_Left:
+        seekReplay((long long)replayStep - 1);
+        break;
+    case Qt::Key_Right:
+        seekReplay(replayStep + 1);
+        break;
+    case Qt::Key_Down:
+        seekReplay((long long)replayStep - 25);
+        break;
+    case Qt::Key_Up:
+        seekReplay(replayStep + 25);
+        break;
+    case Qt::Key_Home:
+        seekReplay(0);
+        break;
+    case Qt::Key_End:
+        seekReplay(LLONG_MAX);
+        break;
+    case Qt::Key_B: {
+        unsigned long long reaction;
+        if(simThread->lastReactionStep(reaction))
+            seekReplay((long long)reaction - 25);
+        break;
+    }
+    case Qt::Key_X:
+        exportReplay();
+        break;
+    case Qt::Key_Space:
+        replayPlaying = !replayPlaying;
+        if(replayPlaying && !timerId) {
+            timerInterval = frameInterval();
+            timerId = startTimer(timerInterval);
+        } else if(!replayPlaying && timerId) {
+            killTimer(timerId);
+            timerId = 0;
+        }
+        viewport()->update();
+        break;
+    default:
+        // os outros (zoom, rotulos, estatisticas) valem no replay tambem,
+        // menos os que mexem na fisica
+        return key == Qt::Key_Q || key == Qt::Key_W || key == Qt::Key_V ||
+                key == Qt::Key_P || key == Qt::Key_Z || key == Qt::Key_K ||
+                key == Qt::Key_BracketLeft || key == Qt::Key_BracketRight;
+    }
+    return true;
+}
+
+// O historico inteiro, passo a passo, pelo FrameExporter. A janela fica
+// parada ate acabar: aqui so se decodifica, o desenho e a gravacao vao
+// para todos os nucleos.
+void GraphWidget::exportReplay()
+{
+    unsigned long long first, last;
+    simThread->historyRange(first, last);
+    SimFrame frame;
+    if(!simThread->seekHistory(first, frame))
+        return;
 
-    if(checkIfMoleculeBounced(mol2,mol2Vx,mol2Vy))
-        mol2Angular *= -1;
-    mol2->moveBy(mol2Vx,mol2Vy);
-    mol2Angle += mol2Angular;
-    mol2->setRotation(mol2Angle);
-    if(checkIfMoleculeBounced(mol2,mol2Vx,mol2Vy))
-        mol2->moveBy(mol2Vx,mol2Vy);
+    QString fileName = replayExportFile.isEmpty() ? QString("replay.png") : replayExportFile;
+    FrameExporter exporter;
+    exporter.setLabels(Atom::labelsVisible());
+    exporter.setWidth(replayExportWidth);
+    if(!exporter.begin(fileName, frame.box))
+    {
+        qWarning("nao consegui gravar %s", qPrintable(fileName));
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QElapsedTimer clock;
+    clock.start();
+    // o historico decodificado uma vez, em ordem; o pool desenha enquanto
+    // os proximos quadros saem
+    bool decoded = simThread->replayHistory([&exporter](const SimFrame &step) {
+        exporter.add(step);
+    });
+    bool written = exporter.finish();
+    QApplication::restoreOverrideCursor();
+
+    if(!decoded)
+        qWarning("o historico acabou antes: %s ficou incompleto", qPrintable(fileName));
+    if(!written)
+        qWarning("alguns quadros de %s nao foram gravados", qPrintable(fileName));
+    qDebug() << exporter.frameCount() << "quadros" << exporter.imageSize()
+             << "em" << clock.elapsed() << "ms ->" << fileName;
+}
 
-    calculateForces();
+// Minimizada ou escondida: a fisica e o timer param ate a janela voltar.
+void GraphWidget::showEvent(QShowEvent *event)
+{
+    QGraphicsView::showEvent(event);
+    if(viewer && viewer->hasFrame())
+        applyFrame(viewer->frame());
+    if(!simThread)
+        return;
+    simThread->setPaused(replaying);
+    itemMoved();
+}
 
-    // calculate forces
+void GraphWidget::hideEvent(QHideEvent *event)
+{
+    QGraphicsView::hideEvent(event);
+    replayPlaying = false;
+    if(!simThread)
+        return;
+    simThread->setPaused(true);
+    if(timerId) {
+        killTimer(timerId);
+        timerId = 0;
+    }
+}
 
+// No modo periodico cada atomo e desenhado dentro da caixa, mesmo que a
+// molecula dele esteja atravessando a borda.
+static QPointF wrapIntoBox(double x, double y, const SimBox &box)
+{
+    box.wrap(x, y);
+    return QPointF(x, y);
 }
 
-void GraphWidget::calculateForces()
+void GraphWidget::applyFrame(const SimFrame &frame)
 {
-    QList<Atom *> molAtomsI;
-    foreach (QGraphicsItem *item, mol1->childItems()) {
-        if (Atom *atom = qgraphicsitem_cast<Atom *>(item))
-            molAtomsI << atom;
+    TRACE_ZONE("applyFrame");
+    currentFrame = &frame;
+
+    // o cenario pode trocar a caixa padrao do construtor
+    QRectF box(frame.box.left, frame.box.top, frame.box.width, frame.box.height);
+    if(box != sceneRect())
+    {
+        scene()->setSceneRect(box);
+        resetCachedContent();
     }
-    QList<Atom *> molAtomsJ;
-    foreach (QGraphicsItem *item, mol2->childItems()) {
-        if (Atom *atom = qgraphicsitem_cast<Atom *>(item))
-            molAtomsJ << atom;
+
+    // so as celulas; dar a volta e calcular ligacoes e para o que a
+    // consulta de updateVisibleItems devolver
+    atomIndex.build(frame.x, frame.y, frame.box);
+    bondIndex.build(atomIndex, frame.bondA);
+
+    lastStats = frame.stats;
+    updateVisibleItems();
+    if(showStats)
+        viewport()->update(0, 0, viewport()->width(), 40);
+    if(analysis)
+    {
+        if(const ObservableReport *report = analysis->takeReport())
+            observed = *report;
+        if(showObservables)
+            viewport()->update(observablesArea());
     }
+    if(frame.stats.pH > 0 || frame.stats.thermostat != Thermostat::Off)
+        viewport()->update(0, viewport()->height() - 56, viewport()->width(), 56);
+}
+
+// Acha o que cai na area visivel (com uma margem) e passa para os itens
+// do pool. O resto da cena continua na simulacao sem custo de desenho.
+void GraphWidget::updateVisibleItems()
+{
+    TRACE_ZONE("updateVisibleItems");
+    if(!currentFrame)
+        return;
+    const SimFrame &frame = *currentFrame;
 
-    qreal r, r3;
-    qreal Fxi = 0;
-    qreal Fxj = 0;
-    qreal Fyi = 0;
-    qreal Fyj = 0;
-    bool doReaction = false;
-    for(int i=0; i<molAtomsI.size(); i++)
+    QRectF exposed = mapToScene(viewport()->rect()).boundingRect();
+    QRectF atomArea = exposed.adjusted(-30, -30, 30, 30);
+    atomIndex.query(atomArea, candidates);
+    visibleAtoms.clear();
+    for(int k = 0; k < candidates.size(); k++)
     {
-            for(int j=0; j<molAtomsJ.size(); j++)
-            {
-                r = sqrt(
-                            (molAtomsI[i]->getAtomPosition().x()-
-                             molAtomsJ[j]->getAtomPosition().x())*
-                            (molAtomsI[i]->getAtomPosition().x()-
-                             molAtomsJ[j]->getAtomPosition().x())
-                            +
-                            (molAtomsI[i]->getAtomPosition().y()-
-                             molAtomsJ[j]->getAtomPosition().y())*
-                            (molAtomsI[i]->getAtomPosition().y()-
-                             molAtomsJ[j]->getAtomPosition().y())
-                            );
-
-                if((i==0) && (reaction) && (r < 40))
-                {
-                    doReaction = true;
-                }
-
-                if(r < (molAtomsI[i]->getRadius()+molAtomsJ[j]->getRadius()))
-                    r=molAtomsI[i]->getRadius()+molAtomsJ[j]->getRadius();
-
-                r3 = (r * r) / 1;
-                Fxi += molAtomsI[i]->getAtomPosition().x()/r3;
-                Fxj -= molAtomsJ[j]->getAtomPosition().x()/r3;
-                Fyi += molAtomsI[i]->getAtomPosition().y()/r3;
-                Fyj -= molAtomsJ[j]->getAtomPosition().y()/r3;
-            }
+        int i = candidates[k];
+        if(atomArea.contains(wrapIntoBox(frame.x[i], frame.y[i], frame.box)))
+            visibleAtoms << i;
     }
 
-    if(doReaction)
+    while(atomPool.size() < visibleAtoms.size())
     {
-        reaction = false;
-        bond4to5->hide();
-
-        mol1->removeFromGroup(atom5);
-        mol1->removeFromGroup(bond4to5);
-        mol2->removeFromGroup(atom6);
-        mol1->addToGroup(atom6);
-        mol2->addToGroup(atom5);
-        atom6->activateDeactivateRotations(false);
-        atom6->setRotation(mol1->rotation());
-        atom6->activateDeactivateRotations(true);
-        atom5->activateDeactivateRotations(false);
-        atom5->setRotation(mol2->rotation());
-        atom5->activateDeactivateRotations(true);
-
-        QPointF keepMol1Pos = mol1->pos();
-        qreal mol1Rot = mol1->rotation();
-
-        mol1->setPos(0,0);
-        mol1->setRotation(0);
-        bond4to6->adjust();
-        mol1->addToGroup(bond4to6);
-        mol1->setPos(keepMol1Pos.x(),keepMol1Pos.y());
-        mol1->setRotation(mol1Rot);
-        bond4to6->show();
+        Atom *atom = new Atom(this, defineAtom(1));
+        scene()->addItem(atom);
+        atomPool << atom;
+        poolElement << 1;
     }
+    for(int k = 0; k < visibleAtoms.size(); k++)
+    {
+        int i = visibleAtoms[k];
+        Atom *atom = atomPool[k];
+        if(poolElement[k] != frame.element[i])
+        {
+            poolElement[k] = frame.element[i];
+            atom->setAtomType(defineAtom(frame.element[i]));
+        }
+        atom->setPos(wrapIntoBox(frame.x[i], frame.y[i], frame.box));
+        atom->show();
+    }
+    for(int k = visibleAtoms.size(); k < atomsShown; k++)
+        atomPool[k]->hide();
+    atomsShown = visibleAtoms.size();
+
+    // a ligacao esta na celula do atomo A; a margem cobre meia ligacao em
+    // volta do ponto medio e mais meia do ponto medio ate A
+    QRectF bondArea = exposed.adjusted(-100, -100, 100, 100);
+    bondIndex.query(bondArea.adjusted(-100, -100, 100, 100), candidates);
+    int shown = 0;
+    for(int k = 0; k < candidates.size(); k++)
+    {
+        int bond = candidates[k];
+        if(!frame.bondVisible[bond])
+            continue;
+        int a = frame.bondA[bond];
+        int b = frame.bondB[bond];
+        QPointF posA = wrapIntoBox(frame.x[a], frame.y[a], frame.box);
+        QPointF posB = wrapIntoBox(frame.x[b], frame.y[b], frame.box);
+        QPointF shift;
+        if(frame.box.periodic)
+        {
+            // onde o destino deveria estar, visto da origem, menos onde ele
+            // foi desenhado
+            double dx = frame.x[b] - frame.x[a];
+            double dy = frame.y[b] - frame.y[a];
+            frame.box.minimumImage(dx, dy);
+            shift = posA + QPointF(dx, dy) - posB;
+            if(shift.manhattanLength() < 1e-6)
+                shift = QPointF();
+        }
+        if(!bondArea.contains((posA + posB + shift) / 2))
+            continue;
+        if(edgePool.size() <= shown)
+        {
+            Edge *edge = new Edge;
+            scene()->addItem(edge);
+            edgePool << edge;
+        }
+        Edge *edge = edgePool[shown++];
+        edge->setBond(bond);
+        edge->adjust(posA, elementInfo(frame.element[a]).radius,
+                     posB, elementInfo(frame.element[b]).radius,
+                     shift);
+        edge->show();
+    }
+    for(int k = shown; k < edgesShown; k++)
+        edgePool[k]->hide();
+    edgesShown = shown;
+}
 
-    mol1Vx += Fxi;
-    mol2Vx += Fxj;
-    mol1Vy += Fyi;
-    mol2Vy += Fyj;
+void GraphWidget::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    updateVisibleItems();
+}
 
+void GraphWidget::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    updateVisibleItems();
 }
 
 #ifndef QT_NO_WHEELEVENT
@@ -341,6 +691,7 @@ void GraphWidget::wheelEvent(QWheelEvent *event)
 
 void GraphWidget::drawBackground(QPainter *painter, const QRectF &rect)
 {
+    TRACE_ZONE("drawBackground");
     Q_UNUSED(rect);
 
     // Shadow
@@ -354,13 +705,7 @@ void GraphWidget::drawBackground(QPainter *painter, const QRectF &rect)
         painter->fillRect(bottomShadow, Qt::darkGray);
     */
 
-    // Fill
-    QLinearGradient gradient(sceneRect.topLeft(), sceneRect.bottomRight());
-    gradient.setColorAt(0, Qt::white);
-    gradient.setColorAt(1, Qt::blue);
-    painter->fillRect(rect.intersected(sceneRect), gradient);
-    painter->setBrush(Qt::NoBrush);
-    painter->drawRect(sceneRect);
+    paintBox(painter, sceneRect, rect);
 
     // Text
     /*
@@ -381,6 +726,182 @@ void GraphWidget::drawBackground(QPainter *painter, const QRectF &rect)
 
 }
 
+// O fundo da caixa; o FrameExporter usa o mesmo.
+void GraphWidget::paintBox(QPainter *painter, const QRectF &box, const QRectF &exposed)
+{
+    // Fill
+    QLinearGradient gradient(box.topLeft(), box.bottomRight());
+    gradient.setColorAt(0, Qt::white);
+    gradient.setColorAt(1, Qt::blue);
+    painter->fillRect(exposed.intersected(box), gradient);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawRect(box);
+}
+
+void GraphWidget::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    Q_UNUSED(rect);
+
+    // os itens ja foram desenhados: com um quadro da simulacao, e o primeiro
+    if(currentFrame && !StartupClock::isFinished())
+        StartupClock::finish("primeiro quadro");
+
+    if(replaying)
+    {
+        unsigned long long first, last;
+        simThread->historyRange(first, last);
+        QString text = tr("replay step %1 (%2 - %3)  history %4 KB  %5")
+                .arg(replayStep).arg(first).arg(last)
+                .arg(simThread->historyBytes() / 1024)
+                .arg(replayPlaying ? tr("playing") : tr("paused"));
+        painter->save();
+        painter->resetTransform();
+        painter->setPen(Qt::darkRed);
+        painter->drawText(8, viewport()->height() - 8, text);
+        painter->restore();
+    }
+
+    // linhas de baixo para cima, depois da do replay
+    int bottom = viewport()->height() - (replaying ? 24 : 8);
+
+    // a solucao em volta: o pH da cinetica e quanto vale cada marcador
+    if(lastStats.pH > 0)
+    {
+        QString text = tr("pH %1  (1 marker = %2 ions)")
+                .arg(lastStats.pH, 0, 'f', 2)
+                .arg(lastStats.ionsPerMarker, 0, 'f', 0);
+        painter->save();
+        painter->resetTransform();
+        painter->setPen(Qt::darkBlue);
+        painter->drawText(8, bottom, text);
+        painter->restore();
+        bottom -= 16;
+    }
+
+    if(lastStats.thermostat != Thermostat::Off)
+    {
+        QString text = tr("thermostat %1  T %2 -> %3  (K, [ ])")
+                .arg(Thermostat::name(lastStats.thermostat))
+                .arg(lastStats.temperature, 0, 'f', 2)
+                .arg(lastStats.targetTemperature, 0, 'f', 2);
+        painter->save();
+        painter->resetTransform();
+        painter->setPen(Qt::darkRed);
+        painter->drawText(8, bottom, text);
+        painter->restore();
+    }
+
+    if(showObservables)
+        drawObservables(painter);
+
+    if(!showStats)
+        return;
+
+    qreal every = lastStats.neighborRebuilds > 0 ?
+                (qreal)lastStats.steps / lastStats.neighborRebuilds : 0;
+    QString text = tr("step %1  pairs %2  neighbor rebuilds %3 (every %4 steps)  awake %5  asleep %6")
+            .arg(lastStats.steps)
+            .arg(lastStats.neighborPairs)
+            .arg(lastStats.neighborRebuilds)
+            .arg(every, 0, 'f', 1)
+            .arg(lastStats.awakeMolecules)
+            .arg(lastStats.sleepingMolecules);
+    // memoria: a simulacao por atomo, e os itens do pool mais os visuais
+    // divididos por elemento
+    int atoms = currentFrame ? (int)currentFrame->x.size() : 0;
+    QString memory = tr("sim %1 B/atom  items %2 x %3 B  visuals %4 x %5 KB")
+            .arg(atoms > 0 ? lastStats.memoryBytes / atoms : 0)
+            .arg(atomPool.size())
+            .arg(sizeof(Atom))
+            .arg(Atom::visualCount())
+            .arg(Atom::visualBytes() / 1024.0, 0, 'f', 1);
+
+    // texto fixo na janela, fora da transformacao da cena
+    painter->save();
+    painter->resetTransform();
+    painter->setPen(Qt::black);
+    painter->drawText(8, 16, text);
+    painter->drawText(8, 32, memory);
+    painter->restore();
+}
+
+// Abaixo da linha de estatisticas: tres linhas de texto e a g(r).
+QRect GraphWidget::observablesArea() const
+{
+    return QRect(0, 40, viewport()->width(), 180);
+}
+
+// As medidas da AnalysisThread: o que ela viu por ultimo, nao
+// necessariamente o passo que esta na tela.
+void GraphWidget::drawObservables(QPainter *painter)
+{
+    QRect area = observablesArea();
+    painter->save();
+    painter->resetTransform();
+    painter->setPen(Qt::darkGreen);
+
+    int y = area.top() + 14;
+    if(observed.samples == 0)
+    {
+        painter->drawText(8, y, tr("measuring..."));
+        painter->restore();
+        return;
+    }
+    painter->drawText(8, y, tr("T %1 (mean %2 +- %3 over %4 frames)  KE %5  PE %6")
+                      .arg(observed.temperature, 0, 'f', 2)
+                      .arg(observed.meanTemperature, 0, 'f', 2)
+                      .arg(observed.sdTemperature, 0, 'f', 2)
+                      .arg(observed.samples)
+                      .arg(observed.kineticEnergy, 0, 'f', 1)
+                      .arg(observed.potentialEnergy, 0, 'f', 1));
+    y += 16;
+    painter->drawText(8, y, tr("reactions %1  rate %2 per 1000 steps (mean %3)")
+                      .arg(observed.reactions)
+                      .arg(observed.reactionRate, 0, 'f', 2)
+                      .arg(observed.meanRate, 0, 'f', 2));
+    y += 16;
+    QStringList parts;
+    for(size_t s = 0; s < observed.species.size(); s++)
+        parts << QString("%1:%2").arg(QString::fromStdString(observed.species[s].first))
+                 .arg(observed.species[s].second);
+    painter->drawText(8, y, tr("species %1").arg(parts.join(' ')));
+
+    // g(r) de 0 a 4, com a linha do gas ideal em 1
+    QRectF plot(8, y + 8, 200, area.bottom() - y - 12);
+    const qreal top = 4;
+    painter->setPen(Qt::gray);
+    painter->drawRect(plot);
+    painter->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+    qreal ideal = plot.bottom() - plot.height() / top;
+    painter->drawLine(QPointF(plot.left(), ideal), QPointF(plot.right(), ideal));
+
+    static const Qt::GlobalColor colors[] = {
+        Qt::red, Qt::blue, Qt::darkGreen, Qt::magenta, Qt::darkCyan, Qt::darkYellow, Qt::black
+    };
+    const int colorCount = sizeof(colors) / sizeof(colors[0]);
+    for(size_t c = 0; c < observed.rdf.size(); c++)
+    {
+        const RdfCurve &curve = observed.rdf[c];
+        QPolygonF line;
+        int bins = (int)curve.g.size();
+        for(int k = 0; k < bins; k++)
+        {
+            qreal g = qMin((qreal)curve.g[k], top);
+            line << QPointF(plot.left() + plot.width() * (k + 0.5) / bins,
+                            plot.bottom() - plot.height() * g / top);
+        }
+        painter->setPen(colors[c % colorCount]);
+        painter->drawPolyline(line);
+        painter->drawText(QPointF(plot.right() + 6, plot.top() + 10 + 11 * c),
+                          QString("%1-%2").arg(elementInfo(curve.elementA).symbol)
+                          .arg(elementInfo(curve.elementB).symbol));
+    }
+    int bins = observed.rdf.empty() ? 0 : (int)observed.rdf[0].g.size();
+    painter->setPen(Qt::gray);
+    painter->drawText(plot.topLeft() + QPointF(4, 12),
+                      tr("g(r), r < %1").arg(observed.rdfBin * bins));
+    painter->restore();
+}
 
 void GraphWidget::scaleView(qreal scaleFactor)
 {
@@ -389,6 +910,7 @@ void GraphWidget::scaleView(qreal scaleFactor)
         return;
 
     scale(scaleFactor, scaleFactor);
+    updateVisibleItems();
 }
 
 void GraphWidget::zoomIn()
@@ -403,31 +925,12 @@ void GraphWidget::zoomOut()
 
 struct atomType GraphWidget::defineAtom(int nAtomic)
 {
+    const ElementInfo &element = elementInfo(nAtomic);
     struct atomType atomOut;
-    switch(nAtomic)
-    {
-    case 1:
-        atomOut.r = 6;
-        atomOut.lightColor = "#ffffff";
-        atomOut.darkColor = "#a0a0a4";
-        atomOut.atomName = "H";
-        break;
-    case 9:
-        atomOut.r = 9;
-        atomOut.lightColor = "#ff0000";
-        atomOut.darkColor = "#800000";
-        atomOut.atomName = "F";
-        break;
-    case 17:
-        atomOut.r = 12;
-        atomOut.lightColor = "#00ff00";
-        atomOut.darkColor = "#008000";
-        atomOut.atomName = "Cl";
-        break;
-    }
-
-    if(!showLabel)
-        atomOut.atomName = "";
+    atomOut.r = element.radius;
+    atomOut.lightColor = element.lightColor;
+    atomOut.darkColor = element.darkColor;
+    atomOut.atomName = element.symbol;
 
     return atomOut;
 }
@@ -46,9 +46,15 @@
 #include <vector>
 
 #include "atomstruct.h"
+#include "simtypes.h"
+#include "observables.h"
+#include "renderindex.h"
 
 class Atom;
 class Edge;
+class SimulationThread;
+class StateClient;
+class AnalysisThread;
 
 //! [0]
 class GraphWidget : public QGraphicsView
@@ -56,14 +62,24 @@ class GraphWidget : public QGraphicsView
     Q_OBJECT
 
 public:
-    GraphWidget(QWidget *parent = 0);
+    GraphWidget(const Scenario &scenario = Scenario(), QWidget *parent = 0);
+    // so visualizador: desenha o que o servidor (--serve) publica, sem fisica
+    explicit GraphWidget(const QString &serverName, QWidget *parent = 0);
+    ~GraphWidget();
 
     void itemMoved();
+    void startAnalysis(const QString &exportFile = QString());
+    void setReplayExport(const QString &fileName, int width = 0);
+
+    static void paintBox(QPainter *painter, const QRectF &box, const QRectF &exposed);
 
 public slots:
     void zoomIn();
     void zoomOut();
 
+private slots:
+    void clientFrame();
+
 protected:
     void keyPressEvent(QKeyEvent *event) Q_DECL_OVERRIDE;
     void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE;
@@ -71,44 +87,73 @@ protected:
     void wheelEvent(QWheelEvent *event) Q_DECL_OVERRIDE;
 #endif
     void drawBackground(QPainter *painter, const QRectF &rect) Q_DECL_OVERRIDE;
+    void drawForeground(QPainter *painter, const QRectF &rect) Q_DECL_OVERRIDE;
+    void scrollContentsBy(int dx, int dy) Q_DECL_OVERRIDE;
+    void resizeEvent(QResizeEvent *event) Q_DECL_OVERRIDE;
+    void showEvent(QShowEvent *event) Q_DECL_OVERRIDE;
+    void hideEvent(QHideEvent *event) Q_DECL_OVERRIDE;
 
     void scaleView(qreal scaleFactor);
 
 private:
+    // o timer so roda enquanto ha algo se mexendo e a janela aparece
     int timerId;
-    qreal _M_Pi;
-
-    // group
-    QGraphicsItemGroup *mol1;
-    Atom *atom4;
-    Atom *atom5;
-    Edge *bond4to5;
-    qreal mol1Vx;
-    qreal mol1Vy;
-    qreal mol1Angle;
-    qreal mol1Angular;
-    QGraphicsItemGroup *mol2;
-    Atom *atom6;
-    qreal mol2Vx;
-    qreal mol2Vy;
-    qreal mol2Angle;
-    qreal mol2Angular;
-    Edge *bond4to6;
-
-    void calculateForces();
-    bool reaction;
-
-    // criar um QList<QGraphicsItemGroup *mol> - e colocar todas as moleculas nele.
-    // QList<Atom *> e QList<Edge *> QList<struct atomProperties*>
-
-    bool checkIfMoleculeBounced(QGraphicsItemGroup *mol, qreal& Vx, qreal& Vy);
-
-    bool showLabel;
+    int timerInterval;
+    int frameInterval() const;
+
+    // a fisica roda na SimulationThread; aqui so os itens que desenham.
+    // No modo visualizador nao ha thread e os quadros vem do viewer.
+    SimulationThread *simThread;
+    StateClient *viewer;
+    const SimFrame *currentFrame;
+    void setupView(const QRectF &box);
+    void applyFrame(const SimFrame &frame);
+
+    // so o que esta na area visivel tem item; os itens sao reaproveitados
+    RenderIndex atomIndex;
+    RenderIndex bondIndex;
+    QVector<int> candidates;
+    QVector<int> visibleAtoms;
+    QList<Atom *> atomPool;
+    QVector<int> poolElement;
+    QList<Edge *> edgePool;
+    int atomsShown;
+    int edgesShown;
+    void updateVisibleItems();
+    void pushCommand(qreal dvx, qreal dvy, qreal dAngular);
+
+    bool flexible;
+    bool periodic;
+    bool sleeping;
+    void postMode(int kind, bool on);
+    void postTitrate(bool acid);
+    void postThermostat(int kind, double target);
+
     void showHideLabels();
+
+    // R: volta no tempo pelo historico da thread, com a fisica pausada
+    bool replaying;
+    bool replayPlaying;
+    unsigned long long replayStep;
+    SimFrame replayFrame;
+    void setReplay(bool on);
+    void seekReplay(long long step);
+    bool replayKey(int key);
+    QString replayExportFile;
+    int replayExportWidth;
+    void exportReplay();
+
+    bool showStats;
+    SimStats lastStats;
+
+    // M: temperatura, g(r), especies e taxa de reacao, medidas numa
+    // AnalysisThread que so comeca quando alguem pede
+    AnalysisThread *analysis;
+    bool showObservables;
+    ObservableReport observed;
+    QRect observablesArea() const;
+    void drawObservables(QPainter *painter);
     struct atomType defineAtom(int nAtomic);
-    struct atomType atomType1;
-    struct atomType atomType2;
-    struct atomType atomType3;
 
 };
 //! [0]
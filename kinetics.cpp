@@ -0,0 +1,245 @@
+#include "kinetics.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace {
+
+const double Avogadro = 6.02214076e23;
+
+// fracao que cada especie pode mudar num salto (o epsilon de Cao,
+// Gillespie e Petzold); menos que SsaEvents eventos esperados no salto e
+// mais barato fazer um por um
+const double LeapEpsilon = 0.03;
+const double SsaEvents = 10;
+const int SsaBatch = 100;
+
+}
+
+StochasticKinetics::StochasticKinetics(unsigned seed)
+    : volume(1e-15), elapsed(0), eventCount(0), leapCount(0), random(seed)
+{
+}
+
+int StochasticKinetics::addSpecies(const std::string &name, long long count)
+{
+    names.push_back(name);
+    counts.push_back(count);
+    return (int)names.size() - 1;
+}
+
+int StochasticKinetics::findSpecies(const std::string &name) const
+{
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        if(names[i] == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+int StochasticKinetics::addRule(int reactantA, int reactantB, int productA, int productB, double rate)
+{
+    Rule rule;
+    rule.reactants[0] = reactantA;
+    rule.reactants[1] = reactantB;
+    rule.products[0] = productA;
+    rule.products[1] = productB;
+    rule.rate = rate;
+    updateConstant(rule);
+    rules.push_back(rule);
+    propensity.push_back(0);
+    return (int)rules.size() - 1;
+}
+
+void StochasticKinetics::setVolume(double liters)
+{
+    volume = liters;
+    for(size_t j = 0; j < rules.size(); j++)
+        updateConstant(rules[j]);
+}
+
+// k macroscopico -> c por molecula (ou par de moleculas) no volume
+void StochasticKinetics::updateConstant(Rule &rule) const
+{
+    double molecules = Avogadro * volume; // por mol/L
+    int order = (rule.reactants[0] >= 0) + (rule.reactants[1] >= 0);
+    if(order == 0)
+        rule.constant = rule.rate * molecules;
+    else if(order == 1)
+        rule.constant = rule.rate;
+    else if(rule.reactants[0] == rule.reactants[1])
+        rule.constant = 2 * rule.rate / molecules;
+    else
+        rule.constant = rule.rate / molecules;
+}
+
+void StochasticKinetics::addConcentration(int species, double molar)
+{
+    long long added = llround(molar * Avogadro * volume);
+    counts[species] = std::max(0LL, counts[species] + added);
+}
+
+double StochasticKinetics::concentration(int species) const
+{
+    return counts[species] / (Avogadro * volume);
+}
+
+double StochasticKinetics::updatePropensities()
+{
+    double total = 0;
+    for(size_t j = 0; j < rules.size(); j++)
+    {
+        const Rule &rule = rules[j];
+        int a = rule.reactants[0];
+        int b = rule.reactants[1];
+        double value = rule.constant;
+        if(a >= 0 && b >= 0 && a == b)
+            value *= 0.5 * counts[a] * (counts[a] - 1);
+        else
+        {
+            if(a >= 0)
+                value *= counts[a];
+            if(b >= 0)
+                value *= counts[b];
+        }
+        propensity[j] = value > 0 ? value : 0;
+        total += propensity[j];
+    }
+    return total;
+}
+
+// O maior tau em que a media e a variancia da mudanca de cada reagente
+// ficam abaixo de epsilon * quantidade.
+double StochasticKinetics::leapSize(double total) const
+{
+    double tau = HUGE_VAL;
+    for(size_t i = 0; i < counts.size(); i++)
+    {
+        double mean = 0;
+        double variance = 0;
+        int order = 0;
+        for(size_t j = 0; j < rules.size(); j++)
+        {
+            const Rule &rule = rules[j];
+            int change = 0;
+            for(int s = 0; s < MaxSides; s++)
+            {
+                if(rule.reactants[s] == (int)i)
+                    change--;
+                if(rule.products[s] == (int)i)
+                    change++;
+            }
+            if(rule.reactants[0] == (int)i || rule.reactants[1] == (int)i)
+                order = std::max(order, (rule.reactants[0] >= 0) + (rule.reactants[1] >= 0));
+            mean += change * propensity[j];
+            variance += change * change * propensity[j];
+        }
+        if(order == 0)
+            continue; // so produzida: nao pode ficar negativa
+        double bound = std::max(LeapEpsilon * counts[i] / order, 1.0);
+        if(mean != 0)
+            tau = std::min(tau, bound / fabs(mean));
+        if(variance > 0)
+            tau = std::min(tau, bound * bound / variance);
+    }
+    return tau < HUGE_VAL ? tau : 1 / total;
+}
+
+void StochasticKinetics::fire(const Rule &rule, long long times)
+{
+    for(int s = 0; s < MaxSides; s++)
+    {
+        if(rule.reactants[s] >= 0)
+            counts[rule.reactants[s]] -= times;
+        if(rule.products[s] >= 0)
+            counts[rule.products[s]] += times;
+    }
+}
+
+// Um salto de tau com Poisson por regra. Se alguma especie ficaria
+// negativa nada muda e quem chamou tenta com tau menor.
+bool StochasticKinetics::leap(double tau)
+{
+    std::vector<long long> saved = counts;
+    unsigned long long fired = 0;
+    for(size_t j = 0; j < rules.size(); j++)
+    {
+        if(propensity[j] <= 0)
+            continue;
+        std::poisson_distribution<long long> events(propensity[j] * tau);
+        long long times = events(random);
+        fire(rules[j], times);
+        fired += times;
+    }
+    for(size_t i = 0; i < counts.size(); i++)
+    {
+        if(counts[i] < 0)
+        {
+            counts.swap(saved);
+            return false;
+        }
+    }
+    eventCount += fired;
+    leapCount++;
+    return true;
+}
+
+void StochasticKinetics::advance(double seconds)
+{
+    double end = elapsed + seconds;
+    std::uniform_real_distribution<double> uniform(0, 1);
+    while(elapsed < end)
+    {
+        double total = updatePropensities();
+        if(total <= 0)
+        {
+            elapsed = end;
+            return;
+        }
+
+        // muitos eventos: salta; se algum reagente acabaria negativo,
+        // salta menos, ate valer mais a pena ir um por um
+        double tau = std::min(leapSize(total), end - elapsed);
+        bool leapt = false;
+        while(tau * total >= SsaEvents)
+        {
+            if(leap(tau))
+            {
+                leapt = true;
+                break;
+            }
+            tau /= 2;
+        }
+        if(leapt)
+        {
+            elapsed += tau;
+            continue;
+        }
+
+        // poucos eventos: Gillespie direto, alguns de cada vez antes de
+        // reavaliar se ja da para saltar
+        for(int k = 0; k < SsaBatch; k++)
+        {
+            double wait = -log(1 - uniform(random)) / total;
+            if(elapsed + wait > end)
+            {
+                elapsed = end;
+                return;
+            }
+            elapsed += wait;
+            double pick = uniform(random) * total;
+            size_t j = 0;
+            while(j + 1 < rules.size() && pick >= propensity[j])
+                pick -= propensity[j++];
+            fire(rules[j], 1);
+            eventCount++;
+            total = updatePropensities();
+            if(total <= 0)
+            {
+                elapsed = end;
+                return;
+            }
+        }
+    }
+}
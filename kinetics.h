@@ -0,0 +1,68 @@
+#ifndef KINETICS_H
+#define KINETICS_H
+
+#include <vector>
+#include <string>
+#include <random>
+
+// Cinetica estocastica de especies contadas, sem posicao: o volume
+// inteiro da solucao, bem misturado. Cada regra e uma reacao de ate dois
+// reagentes e dois produtos com a constante macroscopica (1/s para
+// unimolecular, 1/(M s) para bimolecular); o volume converte para a
+// constante de cada par de moleculas.
+//
+// advance() usa o Gillespie exato quando o intervalo tem poucos eventos
+// e tau-leaping (Poisson por regra, passo limitado para nenhuma especie
+// mudar mais que uma fracao dela) quando tem muitos.
+class StochasticKinetics
+{
+public:
+    enum { MaxSides = 2 };
+
+    struct Rule
+    {
+        int reactants[MaxSides]; // -1 = vazio
+        int products[MaxSides];
+        double rate;             // macroscopica
+        double constant;         // por molecula, ja com o volume
+    };
+
+    explicit StochasticKinetics(unsigned seed = 1);
+
+    int addSpecies(const std::string &name, long long count);
+    int addRule(int reactantA, int reactantB, int productA, int productB, double rate);
+    void setVolume(double liters);
+
+    int speciesCount() const { return (int)names.size(); }
+    const std::string &name(int species) const { return names[species]; }
+    int findSpecies(const std::string &name) const;
+
+    long long count(int species) const { return counts[species]; }
+    void setCount(int species, long long count) { counts[species] = count; }
+    void addConcentration(int species, double molar);
+    double concentration(int species) const; // mol/L
+
+    void advance(double seconds);
+    double time() const { return elapsed; }
+    unsigned long long events() const { return eventCount; }
+    unsigned long long leaps() const { return leapCount; }
+
+private:
+    std::vector<std::string> names;
+    std::vector<long long> counts;
+    std::vector<Rule> rules;
+    std::vector<double> propensity;
+    double volume;      // L
+    double elapsed;     // s
+    unsigned long long eventCount;
+    unsigned long long leapCount;
+    std::mt19937_64 random;
+
+    void updateConstant(Rule &rule) const;
+    double updatePropensities();
+    double leapSize(double total) const;
+    void fire(const Rule &rule, long long times);
+    bool leap(double tau);
+};
+
+#endif // KINETICS_H
@@ -4,21 +4,76 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = learning
 TEMPLATE = app
 
+CONFIG += c++11
+
+# qmake CONFIG+=trace liga as zonas de trace; a tecla T grava trace.json
+trace: DEFINES += COOKINGMETH_TRACE
+
 
 SOURCES += main.cpp \
     edge.cpp \
     graphwidget.cpp \
-    atom.cpp
+    atom.cpp \
+    elements.cpp \
+    simulation.cpp \
+    neighborlist.cpp \
+    bondtopology.cpp \
+    unionfind.cpp \
+    pairpotential.cpp \
+    reactionrules.cpp \
+    kinetics.cpp \
+    bulksolution.cpp \
+    thermostat.cpp \
+    goldenrun.cpp \
+    ensemble.cpp \
+    sweep.cpp \
+    trace.cpp \
+    startupclock.cpp \
+    snapshotcodec.cpp \
+    framehistory.cpp \
+    statestream.cpp \
+    observables.cpp \
+    analysisthread.cpp \
+    frameexport.cpp \
+    simulationthread.cpp \
+    renderindex.cpp
 
 HEADERS  += \
     edge.h \
     graphwidget.h \
     atom.h \
-    atomstruct.h
+    atomstruct.h \
+    elements.h \
+    simulation.h \
+    simtypes.h \
+    neighborlist.h \
+    bondtopology.h \
+    unionfind.h \
+    pairpotential.h \
+    reactionrules.h \
+    kinetics.h \
+    bulksolution.h \
+    thermostat.h \
+    statehash.h \
+    goldenrun.h \
+    ensemble.h \
+    sweep.h \
+    trace.h \
+    startupclock.h \
+    snapshotcodec.h \
+    framehistory.h \
+    statestream.h \
+    observables.h \
+    analysisthread.h \
+    frameexport.h \
+    simulationthread.h \
+    triplebuffer.h \
+    spscqueue.h \
+    renderindex.h
@@ -39,30 +39,541 @@
 ****************************************************************************/
 
 #include "graphwidget.h"
+#include "ensemble.h"
+#include "sweep.h"
+#include "startupclock.h"
+#include "simulationthread.h"
+#include "statestream.h"
+#include "analysisthread.h"
+#include "frameexport.h"
+#include "simulation.h"
+#include "thermostat.h"
+#include "goldenrun.h"
 
 #include <QApplication>
-#include <QTime>
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
 #include <QMainWindow>
+#include <QTimer>
+#include <string.h>
+
+// As opcoes da cena, as mesmas em todos os modos.
+static void addScenarioOptions(QCommandLineParser &parser)
+{
+    parser.addOption(QCommandLineOption("world", "Lado do mundo.", "size", "0"));
+    parser.addOption(QCommandLineOption("pairs", "Pares HCl + F extras.", "count", "0"));
+    parser.addOption(QCommandLineOption("seed", "Semente da cena (da primeira, se forem varias).", "seed", "1"));
+    parser.addOption(QCommandLineOption("ph", "pH da agua em volta (0 = sem agua).", "pH", "0"));
+    parser.addOption(QCommandLineOption("thermostat", "berendsen, rescale ou langevin.", "kind", "off"));
+    parser.addOption(QCommandLineOption("temperature", "Alvo do termostato (0 = o da cena).", "T", "0"));
+}
+
+// A cena das opcoes de addScenarioOptions. Se alguma estiver errada, a
+// mensagem vai para error; senao error fica vazio.
+static Scenario scenarioFromParser(const QCommandLineParser &parser, QString *error)
+{
+    Scenario scenario;
+    scenario.worldSize = parser.value("world").toDouble();
+    scenario.extraPairs = parser.value("pairs").toInt();
+    scenario.seed = parser.value("seed").toUInt();
+    scenario.solutionPH = parser.value("ph").toDouble();
+    scenario.thermostat = Thermostat::kindFromName(qPrintable(parser.value("thermostat")));
+    scenario.targetTemperature = parser.value("temperature").toDouble();
+
+    error->clear();
+    if(scenario.thermostat < 0)
+    {
+        *error = "termostato desconhecido: " + parser.value("thermostat");
+        scenario.thermostat = Thermostat::Off;
+    }
+    return scenario;
+}
+
+// --ensemble N: roda N simulacoes sem janela, em paralelo, e grava um
+// resultado por linha. Ex.: --ensemble 500 --steps 4000 --output runs.csv
+static int runEnsemble(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption ensembleOption("ensemble", "Numero de simulacoes.", "runs");
+    QCommandLineOption stepsOption("steps", "Passos de cada simulacao.", "steps", "3000");
+    QCommandLineOption speedOption("speed-jitter", "Variacao da velocidade inicial.", "speed", "1");
+    QCommandLineOption spinOption("spin-jitter", "Variacao da rotacao inicial.", "spin", "2");
+    QCommandLineOption threadsOption("threads", "Threads (0 = uma por nucleo).", "count", "0");
+    QCommandLineOption outputOption("output", "Arquivo de resultados.", "file", "ensemble.csv");
+    parser.addOption(ensembleOption);
+    parser.addOption(stepsOption);
+    addScenarioOptions(parser);
+    parser.addOption(speedOption);
+    parser.addOption(spinOption);
+    parser.addOption(threadsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString error;
+    RunSpec spec;
+    spec.scenario = scenarioFromParser(parser, &error);
+    if(!error.isEmpty())
+    {
+        out << error << endl;
+        return 1;
+    }
+    spec.steps = parser.value(stepsOption).toInt();
+    spec.speedJitter = parser.value(speedOption).toDouble();
+    spec.spinJitter = parser.value(spinOption).toDouble();
+
+    EnsembleRunner runner;
+    runner.setThreads(parser.value(threadsOption).toInt());
+    int runs = parser.value(ensembleOption).toInt();
+    unsigned seed = spec.scenario.seed;
+    for(int i = 0; i < runs; i++)
+    {
+        spec.seed = seed + i;
+        runner.addRun(spec);
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    runner.run();
+
+    QString fileName = parser.value(outputOption);
+    if(!runner.writeResults(fileName))
+    {
+        out << "nao consegui gravar " << fileName << endl;
+        return 1;
+    }
+
+    int reacted = 0;
+    for(int i = 0; i < runner.runCount(); i++)
+    {
+        if(runner.result(i).reactionStep >= 0)
+            reacted++;
+    }
+    out << runs << " simulacoes em " << clock.elapsed() << " ms, "
+        << reacted << " reagiram -> " << fileName << endl;
+    if(runner.runCount() > 0 && runner.result(0).atoms > 0)
+        out << "memoria da simulacao: " << runner.result(0).memoryBytes / runner.result(0).atoms
+            << " bytes por atomo" << endl;
+    return 0;
+}
+
+// --sweep: grade de encontros H-Cl + F, cada eixo como min:max:pontos.
+// Ex.: --sweep --speed 0.5:4:8 --angle 0:180:7 --distance 20:50:4
+static int runSweep(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption sweepOption("sweep", "Varredura de parametros.");
+    QCommandLineOption speedOption("speed", "Velocidade de aproximacao.", "range", "2");
+    QCommandLineOption spinOption("spin", "Rotacao do H-Cl, graus/passo.", "range", "0");
+    QCommandLineOption angleOption("angle", "Orientacao do H-Cl, graus.", "range", "0");
+    QCommandLineOption distanceOption("distance", "Distancia de reacao.", "range", "40");
+    QCommandLineOption repeatsOption("repeats", "Simulacoes por ponto.", "count", "20");
+    QCommandLineOption stepsOption("steps", "Maximo de passos.", "steps", "1500");
+    QCommandLineOption speedJitterOption("speed-jitter", "Variacao da velocidade inicial.", "speed", "0.1");
+    QCommandLineOption spinJitterOption("spin-jitter", "Variacao da rotacao inicial.", "spin", "0.5");
+    QCommandLineOption threadsOption("threads", "Threads (0 = uma por nucleo).", "count", "0");
+    QCommandLineOption outputOption("output", "Tabela de saida.", "file", "sweep.csv");
+    parser.addOption(sweepOption);
+    parser.addOption(speedOption);
+    parser.addOption(spinOption);
+    parser.addOption(angleOption);
+    parser.addOption(distanceOption);
+    parser.addOption(repeatsOption);
+    parser.addOption(stepsOption);
+    addScenarioOptions(parser);
+    parser.addOption(speedJitterOption);
+    parser.addOption(spinJitterOption);
+    parser.addOption(threadsOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString error;
+    ParameterSweep sweep;
+    sweep.scenario = scenarioFromParser(parser, &error);
+    if(!error.isEmpty())
+    {
+        out << error << endl;
+        return 1;
+    }
+    if(!sweep.speed.parse(parser.value(speedOption)) ||
+            !sweep.spin.parse(parser.value(spinOption)) ||
+            !sweep.angle.parse(parser.value(angleOption)) ||
+            !sweep.distance.parse(parser.value(distanceOption)))
+    {
+        out << "faixa invalida, use min:max:pontos" << endl;
+        return 1;
+    }
+    sweep.repeats = qMax(1, parser.value(repeatsOption).toInt());
+    sweep.steps = parser.value(stepsOption).toInt();
+    sweep.speedJitter = parser.value(speedJitterOption).toDouble();
+    sweep.spinJitter = parser.value(spinJitterOption).toDouble();
+    sweep.setThreads(parser.value(threadsOption).toInt());
+
+    QElapsedTimer clock;
+    clock.start();
+    sweep.run();
+
+    QString fileName = parser.value(outputOption);
+    if(!sweep.writeTable(fileName))
+    {
+        out << "nao consegui gravar " << fileName << endl;
+        return 1;
+    }
+    out << sweep.pointCount() << " pontos x " << sweep.repeats << " simulacoes em "
+        << clock.elapsed() << " ms -> " << fileName << endl;
+    return 0;
+}
+
+// --serve NOME: uma simulacao sem janela publicando o estado num socket
+// local; as janelas abertas com --view NOME so desenham.
+// Ex.: --serve aula --world 3000 --pairs 300
+static int runServer(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption serveOption("serve", "Nome do socket local.", "name");
+    QCommandLineOption observablesOption("observables", "Grava temperatura, g(r) e especies.", "file");
+    parser.addOption(serveOption);
+    addScenarioOptions(parser);
+    parser.addOption(observablesOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString error;
+    Scenario scenario = scenarioFromParser(parser, &error);
+    if(!error.isEmpty())
+    {
+        out << error << endl;
+        return 1;
+    }
+
+    QString name = parser.value(serveOption);
+    StateServer server;
+    if(!server.listen(name))
+    {
+        out << "nao consegui abrir " << name << ": " << server.errorString() << endl;
+        return 1;
+    }
+
+    // declarada antes da thread: so e destruida depois dela parar
+    AnalysisThread analysis;
+    SimulationThread thread(new Simulation, scenario);
+    if(parser.isSet(observablesOption))
+    {
+        analysis.setExport(parser.value(observablesOption));
+        analysis.start();
+        thread.setAnalysis(&analysis);
+    }
+    thread.start();
+
+    // no ritmo em que a simulacao publica; so o ultimo quadro vai
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, [&]() {
+        if(const SimFrame *frame = thread.takeFrame())
+            server.publish(*frame);
+        poll.setInterval(thread.framePeriod());
+    });
+    poll.start(thread.framePeriod());
+
+    // a cada 5 s: quantos visualizadores e quanto cada um recebe
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastBytes = 0;
+    qint64 lastFrames = 0;
+    QTimer report;
+    QObject::connect(&report, &QTimer::timeout, [&]() {
+        double seconds = clock.restart() / 1000.0;
+        qint64 bytes = server.bytesSent() - lastBytes;
+        qint64 frames = server.framesSent() - lastFrames;
+        lastBytes = server.bytesSent();
+        lastFrames = server.framesSent();
+        int viewers = server.viewerCount();
+        out << name << ": " << viewers << " visualizadores, "
+            << frames / seconds << " quadros/s, "
+            << (viewers > 0 ? bytes / seconds / viewers / 1024 : 0) << " KB/s por visualizador"
+            << endl;
+    });
+    report.start(5000);
+
+    out << "servindo " << name << endl;
+    return app.exec();
+}
+
+// --export ARQUIVO: roda a cena sem janela e grava os quadros, bem mais
+// rapido que o tempo real (ver FrameExporter). Em maquina sem tela:
+// QT_QPA_PLATFORM=offscreen.
+// Ex.: --export aula/quadro.png --steps 2000 --every 2 --width 1920
+static int runExport(QGuiApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption exportOption("export", "Arquivo .png (numerados) ou .rgba (cru).", "file");
+    QCommandLineOption stepsOption("steps", "Passos da simulacao.", "steps", "3000");
+    QCommandLineOption everyOption("every", "Passos entre um quadro e outro.", "steps", "1");
+    QCommandLineOption widthOption("width", "Largura da imagem (0 = a da caixa).", "pixels", "0");
+    QCommandLineOption labelsOption("labels", "Escreve o nome dos atomos.");
+    QCommandLineOption threadsOption("threads", "Threads (0 = uma por nucleo).", "count", "0");
+    parser.addOption(exportOption);
+    parser.addOption(stepsOption);
+    parser.addOption(everyOption);
+    parser.addOption(widthOption);
+    parser.addOption(labelsOption);
+    parser.addOption(threadsOption);
+    addScenarioOptions(parser);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString error;
+    Scenario scenario = scenarioFromParser(parser, &error);
+    if(!error.isEmpty())
+    {
+        out << error << endl;
+        return 1;
+    }
+    int steps = parser.value(stepsOption).toInt();
+    int every = qMax(1, parser.value(everyOption).toInt());
+
+    QString fileName = parser.value(exportOption);
+    Simulation sim;
+    sim.loadScenario(scenario);
+    SimFrame frame;
+    sim.writeFrame(frame);
+
+    FrameExporter exporter;
+    exporter.setThreads(parser.value(threadsOption).toInt());
+    exporter.setWidth(parser.value(widthOption).toInt());
+    exporter.setLabels(parser.isSet(labelsOption));
+    if(!exporter.begin(fileName, frame.box))
+    {
+        out << "nao consegui gravar " << fileName << endl;
+        return 1;
+    }
+
+    // a fisica fica nesta thread; cada quadro sai para o pool
+    QElapsedTimer clock;
+    clock.start();
+    exporter.add(frame);
+    for(int step = 1; step <= steps; step++)
+    {
+        sim.step();
+        if(step % every == 0)
+        {
+            sim.writeFrame(frame);
+            exporter.add(frame);
+        }
+    }
+    bool written = exporter.finish();
+    qint64 ms = qMax<qint64>(1, clock.elapsed());
+
+    QSize size = exporter.imageSize();
+    out << exporter.frameCount() << " quadros " << size.width() << "x" << size.height()
+        << " em " << ms << " ms (" << exporter.frameCount() * 1000.0 / ms << " quadros/s) -> "
+        << fileName << endl;
+    if(exporter.isRaw())
+        out << "ffmpeg -f rawvideo -pix_fmt rgba -s " << size.width() << "x" << size.height()
+            << " -r 25 -i " << fileName << " aula.mp4" << endl;
+    if(!written)
+    {
+        out << "alguns quadros nao foram gravados" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// --golden ARQUIVO: trava para otimizacoes. Com --record roda a cena e
+// grava o checksum de cada passo e o tempo; sem, roda de novo a cena do
+// arquivo e falha (saida 1) se algum checksum mudar ou se o passo ficar
+// mais lento que --threshold.
+// Ex.: --golden golden.csv --record --world 3000 --pairs 300 --steps 2000
+//      --golden golden.csv
+static int runGolden(QCoreApplication &app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption goldenOption("golden", "Arquivo da referencia.", "file");
+    QCommandLineOption recordOption("record", "Grava a referencia em vez de comparar.");
+    QCommandLineOption thresholdOption("threshold", "Quanto o passo pode ficar mais lento.", "fraction", "0.1");
+    QCommandLineOption repeatsOption("repeats", "Corridas; vale o tempo da melhor.", "count", "3");
+    QCommandLineOption stepsOption("steps", "Passos.", "steps", "2000");
+    QCommandLineOption everyOption("every", "Passos entre um checksum e outro.", "steps", "1");
+    QCommandLineOption flexibleOption("flexible", "Modo flexivel (molas).");
+    QCommandLineOption periodicOption("periodic", "Caixa periodica.");
+    parser.addOption(goldenOption);
+    parser.addOption(recordOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(repeatsOption);
+    parser.addOption(stepsOption);
+    parser.addOption(everyOption);
+    addScenarioOptions(parser);
+    parser.addOption(flexibleOption);
+    parser.addOption(periodicOption);
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QString fileName = parser.value(goldenOption);
+    GoldenRun current;
+    current.setRepeats(parser.value(repeatsOption).toInt());
+
+    if(parser.isSet(recordOption))
+    {
+        QString error;
+        GoldenSpec spec;
+        spec.scenario = scenarioFromParser(parser, &error);
+        if(!error.isEmpty())
+        {
+            out << error << endl;
+            return 1;
+        }
+        spec.flexible = parser.isSet(flexibleOption);
+        spec.periodic = parser.isSet(periodicOption);
+        spec.steps = parser.value(stepsOption).toInt();
+        spec.every = parser.value(everyOption).toInt();
+        if(!current.run(spec))
+        {
+            out << "as corridas repetidas deram checksums diferentes: nao e deterministica" << endl;
+            return 1;
+        }
+        if(!current.write(fileName))
+        {
+            out << "nao consegui gravar " << fileName << endl;
+            return 1;
+        }
+        out << current.samples().size() << " checksums, " << current.stepMicroseconds()
+            << " us por passo -> " << fileName << endl;
+        return 0;
+    }
+
+    GoldenRun baseline;
+    if(!baseline.read(fileName))
+    {
+        out << "nao consegui ler " << fileName << endl;
+        return 1;
+    }
+    bool deterministic = current.run(baseline.spec());
+    long long diverged = current.firstDivergence(baseline);
+    double slowdown = baseline.stepMicroseconds() > 0 ?
+                current.stepMicroseconds() / baseline.stepMicroseconds() - 1 : 0;
+    double threshold = parser.value(thresholdOption).toDouble();
+
+    out << "passo " << current.stepMicroseconds() << " us (referencia "
+        << baseline.stepMicroseconds() << " us, " << (slowdown >= 0 ? "+" : "")
+        << slowdown * 100 << "%)" << endl;
+    bool failed = false;
+    if(!deterministic)
+    {
+        out << "FALHOU: as corridas repetidas deram checksums diferentes" << endl;
+        failed = true;
+    }
+    if(diverged >= 0)
+    {
+        out << "FALHOU: o estado diverge da referencia no passo " << diverged << endl;
+        failed = true;
+    }
+    if(slowdown > threshold)
+    {
+        out << "FALHOU: mais lento que a referencia alem de " << threshold * 100 << "%" << endl;
+        failed = true;
+    }
+    if(!failed)
+        out << "ok: " << current.samples().size() << " checksums iguais" << endl;
+    return failed ? 1 : 0;
+}
+
+// --serve nome ou --serve=nome, como o QCommandLineParser aceita
+static bool isModeOption(const char *arg, const char *name)
+{
+    if(strncmp(arg, "--", 2) != 0)
+        return false;
+    arg += 2;
+    size_t length = strlen(name);
+    return strncmp(arg, name, length) == 0 && (arg[length] == '\0' || arg[length] == '=');
+}
 
 int main(int argc, char **argv)
 {
+    // sem janela: nem cria a QApplication
+    for(int i = 1; i < argc; i++)
+    {
+        if(isModeOption(argv[i], "ensemble"))
+        {
+            QCoreApplication app(argc, argv);
+            return runEnsemble(app);
+        }
+        if(isModeOption(argv[i], "sweep"))
+        {
+            QCoreApplication app(argc, argv);
+            return runSweep(app);
+        }
+        if(isModeOption(argv[i], "serve"))
+        {
+            QCoreApplication app(argc, argv);
+            return runServer(app);
+        }
+        if(isModeOption(argv[i], "golden"))
+        {
+            QCoreApplication app(argc, argv);
+            return runGolden(app);
+        }
+        // sem janela, mas com fontes e QImage
+        if(isModeOption(argv[i], "export"))
+        {
+            QGuiApplication app(argc, argv);
+            return runExport(app);
+        }
+    }
+
+    StartupClock::start();
     QApplication app(argc, argv);
-    qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
+    StartupClock::mark("QApplication");
+    // nada sorteia fora da Simulation: a cena toda vem da --seed
+
+    // cenas maiores que a janela: --world 4000 --pairs 500
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption viewOption("view", "So desenha o que um --serve publica.", "name");
+    QCommandLineOption observablesOption("observables", "Grava temperatura, g(r) e especies.", "file");
+    QCommandLineOption replayExportOption("replay-export", "Onde o X do replay grava os quadros.", "file");
+    QCommandLineOption widthOption("width", "Largura dos quadros gravados (0 = a da caixa).", "pixels", "0");
+    addScenarioOptions(parser);
+    parser.addOption(viewOption);
+    parser.addOption(observablesOption);
+    parser.addOption(replayExportOption);
+    parser.addOption(widthOption);
+    parser.process(app);
+
+    QString error;
+    Scenario scenario = scenarioFromParser(parser, &error);
+    if(!error.isEmpty())
+    {
+        QTextStream(stdout) << error << endl;
+        return 1;
+    }
+    StartupClock::mark("argumentos");
 
-    GraphWidget *widget = new GraphWidget;
+    GraphWidget *widget = parser.isSet(viewOption) ?
+                new GraphWidget(parser.value(viewOption)) : new GraphWidget(scenario);
+    if(parser.isSet(observablesOption))
+        widget->startAnalysis(parser.value(observablesOption));
+    widget->setReplayExport(parser.value(replayExportOption), parser.value(widthOption).toInt());
 
     QMainWindow mainWindow;
     mainWindow.setFixedHeight(500);
     mainWindow.setFixedWidth(500);
     mainWindow.setCentralWidget(widget);
     mainWindow.show();
+    StartupClock::mark("mostrar a janela");
 
     return app.exec();
 }
 
 /*
  * - Preciso de uma cena mais maleavel, que seja facil adicionar mais coisas.
- * - Colocar um botao que altera o pH, ai H+ e OH- vao surgindo do nada.
  * - Corrigir a rotacao da sombra do fluor depois da reacao.
  *
  *
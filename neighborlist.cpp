@@ -0,0 +1,174 @@
+#include "neighborlist.h"
+
+#include <math.h>
+
+// Skin medida nas cenas do programa (corte 57): o H de um HCl girando anda
+// 10 a 20 por passo, e com 30 (reconstroi a 15) a lista quase nunca era
+// reaproveitada. Com 80 os pares dobram e o passo sai mais barato; acima
+// de 100 os pares extras ja custam mais que as reconstrucoes poupadas.
+NeighborList::NeighborList()
+    : cut(150), skinDistance(80), valid(false), builds(0)
+{
+}
+
+void NeighborList::setCutoff(double value)
+{
+    cut = value;
+    valid = false;
+}
+
+size_t NeighborList::memoryUsage() const
+{
+    return vectorBytes(start) + vectorBytes(neighbors) + vectorBytes(refX) + vectorBytes(refY) +
+            vectorBytes(cellStart) + vectorBytes(cellAtoms) + vectorBytes(atomCell);
+}
+
+void NeighborList::setSkin(double value)
+{
+    skinDistance = value;
+    valid = false;
+}
+
+void NeighborList::invalidate()
+{
+    valid = false;
+}
+
+bool NeighborList::update(const std::vector<SimAtom> &atoms, const SimBox &box)
+{
+    if(valid && !needsRebuild(atoms, box))
+        return false;
+
+    build(atoms, box);
+    return true;
+}
+
+bool NeighborList::needsRebuild(const std::vector<SimAtom> &atoms, const SimBox &box) const
+{
+    if(atoms.size() != refX.size())
+        return true;
+
+    double limit = 0.25 * skinDistance * skinDistance;
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        double dx = atoms[i].x - refX[i];
+        double dy = atoms[i].y - refY[i];
+        box.minimumImage(dx, dy);
+        if(dx * dx + dy * dy > limit)
+            return true;
+    }
+    return false;
+}
+
+void NeighborList::build(const std::vector<SimAtom> &atoms, const SimBox &box)
+{
+    int n = (int)atoms.size();
+    valid = true;
+    builds++;
+
+    refX.resize(n);
+    refY.resize(n);
+    start.assign(n + 1, 0);
+    neighbors.clear();
+    if(n == 0)
+        return;
+
+    double range = cut + skinDistance;
+    double range2 = range * range;
+
+    // com paredes a grade cobre os atomos; no modo periodico cobre a caixa
+    // e o indice da celula da a volta
+    double minX = atoms[0].x, maxX = atoms[0].x;
+    double minY = atoms[0].y, maxY = atoms[0].y;
+    for(int i = 0; i < n; i++)
+    {
+        refX[i] = atoms[i].x;
+        refY[i] = atoms[i].y;
+        if(atoms[i].x < minX) minX = atoms[i].x;
+        if(atoms[i].x > maxX) maxX = atoms[i].x;
+        if(atoms[i].y < minY) minY = atoms[i].y;
+        if(atoms[i].y > maxY) maxY = atoms[i].y;
+    }
+
+    int nx, ny;
+    double cellW, cellH;
+    if(box.periodic)
+    {
+        minX = box.left;
+        minY = box.top;
+        nx = (int)(box.width / range);
+        ny = (int)(box.height / range);
+        // com menos de 3 celulas os vizinhos se repetiriam: uma celula so
+        if(nx < 3)
+            nx = 1;
+        if(ny < 3)
+            ny = 1;
+        cellW = box.width / nx;
+        cellH = box.height / ny;
+    }
+    else
+    {
+        nx = (int)((maxX - minX) / range) + 1;
+        ny = (int)((maxY - minY) / range) + 1;
+        cellW = cellH = range;
+    }
+
+    // ordena os atomos por celula (counting sort)
+    cellStart.assign(nx * ny + 1, 0);
+    cellAtoms.resize(n);
+    atomCell.resize(n);
+    for(int i = 0; i < n; i++)
+    {
+        int cx = (int)floor((atoms[i].x - minX) / cellW);
+        int cy = (int)floor((atoms[i].y - minY) / cellH);
+        if(box.periodic)
+        {
+            cx = ((cx % nx) + nx) % nx;
+            cy = ((cy % ny) + ny) % ny;
+        }
+        atomCell[i] = cy * nx + cx;
+        cellStart[atomCell[i] + 1]++;
+    }
+    for(int c = 0; c < nx * ny; c++)
+        cellStart[c + 1] += cellStart[c];
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for(int i = 0; i < n; i++)
+        cellAtoms[fill[atomCell[i]]++] = i;
+
+    int reachX = nx == 1 ? 0 : 1;
+    int reachY = ny == 1 ? 0 : 1;
+    for(int i = 0; i < n; i++)
+    {
+        int cx = atomCell[i] % nx;
+        int cy = atomCell[i] / nx;
+        for(int oy = cy - reachY; oy <= cy + reachY; oy++)
+        {
+            int wy = oy;
+            if(box.periodic)
+                wy = (oy + ny) % ny;
+            else if(oy < 0 || oy >= ny)
+                continue;
+            for(int ox = cx - reachX; ox <= cx + reachX; ox++)
+            {
+                int wx = ox;
+                if(box.periodic)
+                    wx = (ox + nx) % nx;
+                else if(ox < 0 || ox >= nx)
+                    continue;
+                int c = wy * nx + wx;
+                for(int k = cellStart[c]; k < cellStart[c + 1]; k++)
+                {
+                    int j = cellAtoms[k];
+                    if(j <= i || atoms[j].molecule == atoms[i].molecule)
+                        continue;
+                    double dx = atoms[i].x - atoms[j].x;
+                    double dy = atoms[i].y - atoms[j].y;
+                    box.minimumImage(dx, dy);
+                    if(dx * dx + dy * dy < range2)
+                        neighbors.push_back(j);
+                }
+            }
+        }
+        start[i + 1] = (int)neighbors.size();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include <vector>
+
+#include "simtypes.h"
+
+// Lista de Verlet: para cada atomo i, os atomos j > i de outras moleculas
+// a menos de cutoff + skin, guardados em CSR (start/neighbors). So e
+// reconstruida quando algum atomo andou mais que skin/2 desde a ultima
+// construcao, ou quando alguem chama invalidate() (mudou a topologia).
+// No modo periodico a grade da a volta na caixa e as distancias usam a
+// menor imagem.
+class NeighborList
+{
+public:
+    NeighborList();
+
+    void setCutoff(double value);
+    void setSkin(double value);
+    double cutoff() const { return cut; }
+    double skin() const { return skinDistance; }
+
+    void invalidate();
+    bool update(const std::vector<SimAtom> &atoms, const SimBox &box); // true se reconstruiu
+
+    int begin(int i) const { return start[i]; }
+    int end(int i) const { return start[i + 1]; }
+    int neighbor(int k) const { return neighbors[k]; }
+    int pairCount() const { return (int)neighbors.size(); }
+    unsigned long long buildCount() const { return builds; }
+    size_t memoryUsage() const;
+
+private:
+    double cut;
+    double skinDistance;
+    bool valid;
+    unsigned long long builds;
+
+    std::vector<int> start;
+    std::vector<int> neighbors;
+    std::vector<double> refX, refY;
+
+    // grade usada so na construcao, tambem em CSR
+    std::vector<int> cellStart;
+    std::vector<int> cellAtoms;
+    std::vector<int> atomCell;
+
+    bool needsRebuild(const std::vector<SimAtom> &atoms, const SimBox &box) const;
+    void build(const std::vector<SimAtom> &atoms, const SimBox &box);
+};
+
+#endif // NEIGHBORLIST_H
@@ -0,0 +1,242 @@
+#include "observables.h"
+#include "elements.h"
+#include "unionfind.h"
+
+#include <math.h>
+#include <algorithm>
+
+static const double Pi = 3.14159265358979323846264338327950288419717;
+
+// a taxa "recente" esquece o que passou ha mais de uns 500 passos
+static const double RateWindow = 500;
+
+Observables::Observables(double rdfRange, int rdfBins)
+    : range(rdfRange), bins(rdfBins)
+{
+    clear();
+}
+
+void Observables::clear()
+{
+    firstStep = lastStep = 0;
+    firstReactions = lastReactions = 0;
+    samples = 0;
+    temperature = RunningStats();
+    rate = 0;
+    latest = SimStats();
+    species.clear();
+    histograms.clear();
+}
+
+void Observables::add(const SimFrame &frame)
+{
+    // o passo voltou ou o contador de reacoes caiu: e outra cena
+    if(samples > 0 && (frame.step < lastStep || frame.stats.reactions < lastReactions))
+        clear();
+
+    if(samples == 0)
+    {
+        firstStep = frame.step;
+        firstReactions = frame.stats.reactions;
+    }
+    else if(frame.step > lastStep)
+    {
+        double steps = (double)(frame.step - lastStep);
+        double instant = (frame.stats.reactions - lastReactions) * 1000.0 / steps;
+        rate += (1 - exp(-steps / RateWindow)) * (instant - rate);
+    }
+    lastStep = frame.step;
+    lastReactions = frame.stats.reactions;
+    latest = frame.stats;
+    samples++;
+
+    temperature.add(frame.stats.temperature);
+    addRdf(frame);
+    countSpecies(frame);
+}
+
+Observables::Histogram &Observables::histogram(int elementA, int elementB)
+{
+    if(elementA > elementB)
+        std::swap(elementA, elementB);
+    for(size_t h = 0; h < histograms.size(); h++)
+    {
+        if(histograms[h].elementA == elementA && histograms[h].elementB == elementB)
+            return histograms[h];
+    }
+    Histogram created;
+    created.elementA = elementA;
+    created.elementB = elementB;
+    created.counts.assign(bins, 0);
+    created.norm = 0;
+    histograms.push_back(created);
+    return histograms.back();
+}
+
+// Conta os pares ate o alcance numa grade de celulas do tamanho dele; a
+// normalizacao de cada par soma o que um gas ideal com as mesmas
+// quantidades teria, quadro a quadro. Com paredes a borda fica de fora
+// e a g(r) cai um pouco no fim do alcance. Os marcadores da solucao
+// (no fim do quadro) nao entram.
+void Observables::addRdf(const SimFrame &frame)
+{
+    int n = (int)(frame.x.size() - frame.solutionAtoms);
+    double area = frame.box.width * frame.box.height;
+    if(n < 2 || area <= 0)
+        return;
+
+    // quantos de cada elemento: entra na normalizacao de todos os pares
+    std::map<int, int> present;
+    for(int i = 0; i < n; i++)
+        present[frame.element[i]]++;
+    std::vector<int> elements;
+    for(std::map<int, int>::const_iterator a = present.begin(); a != present.end(); ++a)
+    {
+        for(std::map<int, int>::const_iterator b = a; b != present.end(); ++b)
+        {
+            double pairs = a == b ? 0.5 * a->second * (a->second - 1)
+                                  : (double)a->second * b->second;
+            histogram(a->first, b->first).norm += pairs / area;
+        }
+        elements.push_back(a->first);
+    }
+
+    // o histograma de cada par de elementos do quadro, ja achado; todos ja
+    // existem depois do laco de cima, entao os ponteiros nao mudam
+    int kinds = (int)elements.size();
+    std::vector<int> kindOf(n);
+    for(int i = 0; i < n; i++)
+        kindOf[i] = (int)(std::lower_bound(elements.begin(), elements.end(), frame.element[i]) - elements.begin());
+    std::vector<std::vector<double> *> pairCounts(kinds * kinds);
+    for(int a = 0; a < kinds; a++)
+    {
+        for(int b = 0; b < kinds; b++)
+            pairCounts[a * kinds + b] = &histogram(elements[a], elements[b]).counts;
+    }
+
+    int nx = std::max(1, (int)(frame.box.width / range));
+    int ny = std::max(1, (int)(frame.box.height / range));
+    double cellW = frame.box.width / nx;
+    double cellH = frame.box.height / ny;
+    std::vector<int> cellOf(n);
+    cellStart.assign(nx * ny + 1, 0);
+    for(int i = 0; i < n; i++)
+    {
+        int cx = std::min(nx - 1, std::max(0, (int)((frame.x[i] - frame.box.left) / cellW)));
+        int cy = std::min(ny - 1, std::max(0, (int)((frame.y[i] - frame.box.top) / cellH)));
+        cellOf[i] = cy * nx + cx;
+        cellStart[cellOf[i] + 1]++;
+    }
+    for(int c = 0; c < nx * ny; c++)
+        cellStart[c + 1] += cellStart[c];
+    cellAtoms.resize(n);
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for(int i = 0; i < n; i++)
+        cellAtoms[fill[cellOf[i]]++] = i;
+
+    double range2 = range * range;
+    double binWidth = range / bins;
+    for(int i = 0; i < n; i++)
+    {
+        int cx = cellOf[i] % nx;
+        int cy = cellOf[i] / nx;
+
+        // as celulas vizinhas, sem repetir quando a grade e estreita
+        int around[9];
+        int count = 0;
+        for(int dy = -1; dy <= 1; dy++)
+        {
+            for(int dx = -1; dx <= 1; dx++)
+            {
+                int x = cx + dx;
+                int y = cy + dy;
+                if(frame.box.periodic)
+                {
+                    x = (x + nx) % nx;
+                    y = (y + ny) % ny;
+                }
+                else if(x < 0 || x >= nx || y < 0 || y >= ny)
+                    continue;
+                int cell = y * nx + x;
+                if(std::find(around, around + count, cell) == around + count)
+                    around[count++] = cell;
+            }
+        }
+
+        for(int c = 0; c < count; c++)
+        {
+            for(int k = cellStart[around[c]]; k < cellStart[around[c] + 1]; k++)
+            {
+                int j = cellAtoms[k];
+                if(j <= i)
+                    continue;
+                double dx = frame.x[j] - frame.x[i];
+                double dy = frame.y[j] - frame.y[i];
+                frame.box.minimumImage(dx, dy);
+                double r2 = dx * dx + dy * dy;
+                if(r2 >= range2)
+                    continue;
+                int bin = std::min(bins - 1, (int)(sqrt(r2) / binWidth));
+                (*pairCounts[kindOf[i] * kinds + kindOf[j]])[bin]++;
+            }
+        }
+    }
+}
+
+// Cada pedaco ligado do quadro e uma molecula. Ligacoes ja quebradas
+// continuam no quadro (invisiveis) e nao juntam nada.
+void Observables::countSpecies(const SimFrame &frame)
+{
+    int n = (int)(frame.x.size() - frame.solutionAtoms);
+    size_t bonds = frame.bondA.size() - frame.solutionBonds;
+    UnionFind pieces;
+    for(int i = 0; i < n; i++)
+        pieces.add();
+    for(size_t b = 0; b < bonds; b++)
+    {
+        if(frame.bondVisible[b])
+            pieces.unite(frame.bondA[b], frame.bondB[b]);
+    }
+
+    std::map<int, std::vector<int> > molecules;
+    for(int i = 0; i < n; i++)
+        molecules[pieces.find(i)].push_back(frame.element[i]);
+
+    species.clear();
+    for(std::map<int, std::vector<int> >::const_iterator m = molecules.begin();
+        m != molecules.end(); ++m)
+        species[molecularFormula(m->second)]++;
+}
+
+void Observables::report(ObservableReport &out) const
+{
+    out.step = lastStep;
+    out.samples = samples;
+    out.temperature = latest.temperature;
+    out.meanTemperature = temperature.mean;
+    out.sdTemperature = sqrt(temperature.variance());
+    out.kineticEnergy = latest.kineticEnergy;
+    out.potentialEnergy = latest.potentialEnergy;
+    out.reactions = latest.reactions;
+    out.reactionRate = rate;
+    out.meanRate = lastStep > firstStep ?
+                (lastReactions - firstReactions) * 1000.0 / (lastStep - firstStep) : 0;
+    out.species.assign(species.begin(), species.end());
+
+    out.rdfBin = range / bins;
+    out.rdf.resize(histograms.size());
+    for(size_t h = 0; h < histograms.size(); h++)
+    {
+        const Histogram &histogram = histograms[h];
+        RdfCurve &curve = out.rdf[h];
+        curve.elementA = histogram.elementA;
+        curve.elementB = histogram.elementB;
+        curve.g.resize(bins);
+        for(int k = 0; k < bins; k++)
+        {
+            double shell = Pi * ((k + 1) * (k + 1) - k * k) * out.rdfBin * out.rdfBin;
+            double ideal = histogram.norm * shell;
+            curve.g[k] = ideal > 0 ? histogram.counts[k] / ideal : 0;
+        }
+    }
+}
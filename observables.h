@@ -0,0 +1,104 @@
+#ifndef OBSERVABLES_H
+#define OBSERVABLES_H
+
+#include <vector>
+#include <string>
+#include <map>
+
+#include "simtypes.h"
+
+// Media e desvio sem guardar as amostras (Welford).
+struct RunningStats
+{
+    long long count;
+    double mean;
+    double m2;
+
+    RunningStats() : count(0), mean(0), m2(0) {}
+    void add(double value)
+    {
+        count++;
+        double delta = value - mean;
+        mean += delta / count;
+        m2 += delta * (value - mean);
+    }
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+};
+
+// g(r) de um par de elementos, ja normalizada pelo gas ideal da caixa.
+struct RdfCurve
+{
+    int elementA, elementB;
+    std::vector<double> g;
+};
+
+// O que a janela mostra e o que vai para o arquivo: uma copia pequena,
+// tirada do Observables de tempos em tempos.
+struct ObservableReport
+{
+    unsigned long long step;
+    long long samples;      // quadros analisados
+    double temperature;
+    double meanTemperature;
+    double sdTemperature;
+    double kineticEnergy;
+    double potentialEnergy;
+    int reactions;
+    double reactionRate;    // reacoes por 1000 passos, media recente
+    double meanRate;        // desde o inicio
+    std::vector<std::pair<std::string, int> > species; // "HCl", quantas
+    double rdfBin;
+    std::vector<RdfCurve> rdf;
+
+    ObservableReport()
+        : step(0), samples(0), temperature(0), meanTemperature(0), sdTemperature(0),
+          kineticEnergy(0), potentialEnergy(0), reactions(0), reactionRate(0), meanRate(0),
+          rdfBin(0) {}
+};
+
+// Medidas tiradas quadro a quadro, sem guardar a trajetoria: somas
+// corridas para energia e temperatura, histogramas que so acumulam para
+// a g(r) de cada par de elementos, e as moleculas contadas pelas ligacoes
+// do quadro. Pode pular quadros a vontade: a taxa de reacao usa o
+// contador e o numero do passo, nao quantos quadros chegaram.
+//
+// Nao sabe de threads; a AnalysisThread e que chama add() fora da fisica.
+class Observables
+{
+public:
+    explicit Observables(double rdfRange = 100, int rdfBins = 50);
+
+    void clear();
+    void add(const SimFrame &frame);
+    void report(ObservableReport &out) const;
+
+private:
+    double range;
+    int bins;
+
+    unsigned long long firstStep, lastStep;
+    int firstReactions, lastReactions;
+    long long samples;
+    RunningStats temperature;
+    double rate;
+    SimStats latest;
+    std::map<std::string, int> species;
+
+    // um histograma por par (a <= b) de elementos que ja apareceu
+    struct Histogram
+    {
+        int elementA, elementB;
+        std::vector<double> counts;
+        double norm; // soma de (pares / area) dos quadros
+    };
+    std::vector<Histogram> histograms;
+    Histogram &histogram(int elementA, int elementB);
+
+    // grade de celulas do tamanho do alcance, refeita a cada quadro
+    std::vector<int> cellStart, cellAtoms;
+
+    void addRdf(const SimFrame &frame);
+    void countSpecies(const SimFrame &frame);
+};
+
+#endif // OBSERVABLES_H
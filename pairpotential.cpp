@@ -0,0 +1,286 @@
+#include "pairpotential.h"
+#include "elements.h"
+#include "reactionrules.h"
+
+#include <math.h>
+
+PairPotential PairPotential::lennardJones(double epsilon, double sigma, double cutoff)
+{
+    PairPotential term;
+    term.kind = LennardJones;
+    term.epsilon = epsilon;
+    term.sigma = sigma;
+    term.softness = 0;
+    term.screening = 0;
+    term.minDistance = 0.8 * sigma;
+    term.cutoff = cutoff;
+    term.switchStart = 0.8 * cutoff;
+    return term;
+}
+
+PairPotential PairPotential::softCore(double epsilon, double sigma, double softness, double cutoff)
+{
+    PairPotential term = lennardJones(epsilon, sigma, cutoff);
+    term.kind = SoftCore;
+    term.softness = softness;
+    term.minDistance = 0;
+    return term;
+}
+
+PairPotential PairPotential::screenedCoulomb(double strength, double screening,
+                                             double minDistance, double cutoff)
+{
+    PairPotential term;
+    term.kind = ScreenedCoulomb;
+    term.epsilon = strength;
+    term.sigma = 0;
+    term.softness = 0;
+    term.screening = screening;
+    term.minDistance = minDistance;
+    term.cutoff = cutoff;
+    term.switchStart = 0.8 * cutoff;
+    return term;
+}
+
+PairTable::PairTable()
+    : start2(0), cut2(0), invStep(0), lastSample(0)
+{
+}
+
+void PairTable::clear()
+{
+    terms.clear();
+    values.clear();
+    start2 = cut2 = invStep = 0;
+    lastSample = 0;
+}
+
+void PairTable::addTerm(const PairPotential &term)
+{
+    terms.push_back(term);
+}
+
+double PairTable::cutoff() const
+{
+    return sqrt(cut2);
+}
+
+void PairTable::build(int samples)
+{
+    start2 = cut2 = 0;
+    for(size_t i = 0; i < terms.size(); i++)
+    {
+        double min2 = terms[i].minDistance * terms[i].minDistance;
+        double max2 = terms[i].cutoff * terms[i].cutoff;
+        if(min2 > start2)
+            start2 = min2;
+        if(max2 > cut2)
+            cut2 = max2;
+    }
+    values.assign(2 * (samples + 1), 0);
+    lastSample = samples - 1;
+    if(cut2 <= start2)
+    {
+        cut2 = 0;
+        return;
+    }
+
+    double step = (cut2 - start2) / samples;
+    invStep = 1 / step;
+    for(int k = 0; k <= samples; k++)
+        sample(start2 + k * step, values[2 * k + 1], values[2 * k]);
+}
+
+// Valor exato, so usado para montar a tabela. O corte suave e o switch
+// do CHARMM em r^2, que leva energia e forca a zero no cutoff.
+void PairTable::sample(double r2, double &forceOverR, double &energy) const
+{
+    forceOverR = energy = 0;
+    for(size_t i = 0; i < terms.size(); i++)
+    {
+        const PairPotential &term = terms[i];
+        double rc2 = term.cutoff * term.cutoff;
+        if(r2 >= rc2)
+            continue;
+
+        double u = 0, f = 0;
+        if(term.kind == PairPotential::LennardJones)
+        {
+            double x = term.sigma * term.sigma / r2;
+            double x3 = x * x * x;
+            double x6 = x3 * x3;
+            u = 4 * term.epsilon * (x6 - x3);
+            f = 24 * term.epsilon * (2 * x6 - x3) / r2;
+        }
+        else if(term.kind == PairPotential::SoftCore)
+        {
+            // LJ com (r/sigma)^6 trocado por alpha + (r/sigma)^6: finito em r = 0
+            double s2 = term.sigma * term.sigma;
+            double y = r2 * r2 * r2 / (s2 * s2 * s2);
+            double d = term.softness + y;
+            u = 4 * term.epsilon * (1 / (d * d) - 1 / d);
+            double dudy = 4 * term.epsilon * (-2 / (d * d * d) + 1 / (d * d));
+            f = -6 * dudy * r2 * r2 / (s2 * s2 * s2);
+        }
+        else
+        {
+            double r = sqrt(r2);
+            double screen = exp(-term.screening * r);
+            u = term.epsilon * screen / r;
+            f = term.epsilon * screen * (1 + term.screening * r) / (r2 * r);
+        }
+
+        double rs2 = term.switchStart * term.switchStart;
+        if(r2 > rs2)
+        {
+            double width = rc2 - rs2;
+            double norm = width * width * width;
+            double s = (rc2 - r2) * (rc2 - r2) * (rc2 + 2 * r2 - 3 * rs2) / norm;
+            double ds = 6 * (rc2 - r2) * (rs2 - r2) / norm;
+            f = f * s - 2 * u * ds;
+            u *= s;
+        }
+        energy += u;
+        forceOverR += f;
+    }
+}
+
+PairPotentials::PairPotentials()
+    : types(elementTypeCount()), contactMargin(10)
+{
+    matrix.resize(types * types);
+    terms.resize(types * types);
+    for(int a = 0; a < types; a++)
+    {
+        for(int b = a; b < types; b++)
+        {
+            matrix[a * types + b].reaction2 = 0;
+            rebuild(a, b);
+        }
+    }
+}
+
+// Soft-core com o minimo na soma dos raios, para todos os pares. O LJ puro
+// e duro demais para um passo por quadro: um H a 2 px/passo entra fundo na
+// parede r^-12 e sai com energia de sobra. So H + F reage.
+void PairPotentials::loadDefaults()
+{
+    const double softness = 0.7;
+    for(int a = 0; a < types; a++)
+    {
+        for(int b = a; b < types; b++)
+        {
+            const ElementInfo &infoA = elementInfoByType(a);
+            const ElementInfo &infoB = elementInfoByType(b);
+            // o minimo do soft-core fica em (2 - alpha)^(1/6) sigma
+            double sigma = (infoA.radius + infoB.radius) / pow(2 - softness, 1.0 / 6.0);
+            set(infoA.atomicNumber, infoB.atomicNumber,
+                PairPotential::softCore(0.5, sigma, softness, 2.5 * sigma));
+        }
+    }
+    // as reacoes de contato da tabela comum com a BulkSolution
+    for(int i = 0; i < reactionRuleCount(); i++)
+    {
+        const ReactionRule &rule = reactionRule(i);
+        if(rule.elementA > 0 && rule.elementB > 0)
+            setReaction(rule.elementA, rule.elementB, rule.distance);
+    }
+}
+
+void PairPotentials::set(int elementA, int elementB, const PairPotential &term)
+{
+    int a, b;
+    pairTypes(elementA, elementB, a, b);
+    terms[a * types + b].clear();
+    add(elementA, elementB, term);
+}
+
+void PairPotentials::add(int elementA, int elementB, const PairPotential &term)
+{
+    int a, b;
+    pairTypes(elementA, elementB, a, b);
+    terms[a * types + b].push_back(term);
+    rebuild(a, b);
+}
+
+void PairPotentials::setReaction(int elementA, int elementB, double distance)
+{
+    int a, b;
+    pairTypes(elementA, elementB, a, b);
+    matrix[a * types + b].reaction2 = distance * distance;
+    rebuild(a, b);
+}
+
+void PairPotentials::setContactMargin(double margin)
+{
+    contactMargin = margin;
+    for(int a = 0; a < types; a++)
+    {
+        for(int b = a; b < types; b++)
+            rebuild(a, b);
+    }
+}
+
+// Os termos e os parametros ficam na metade de cima da matriz (a <= b).
+void PairPotentials::pairTypes(int elementA, int elementB, int &a, int &b) const
+{
+    a = elementType(elementA);
+    b = elementType(elementB);
+    if(a > b)
+    {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+}
+
+// Escolhe o kernel e copia os coeficientes; a metade de baixo da matriz
+// e copia da de cima.
+void PairPotentials::rebuild(int a, int b)
+{
+    PairParams &p = matrix[a * types + b];
+    const std::vector<PairPotential> &list = terms[a * types + b];
+
+    double touch = elementInfoByType(a).radius + elementInfoByType(b).radius;
+    double contact = touch + contactMargin;
+    p.touch2 = touch * touch;
+    p.contact2 = contact * contact;
+
+    p.table.clear();
+    for(size_t i = 0; i < list.size(); i++)
+        p.table.addTerm(list[i]);
+    p.table.build();
+    p.cut2 = p.table.cutoff() * p.table.cutoff();
+
+    p.kernel = TabulatedKernel;
+    p.epsilon4 = p.sigma2 = p.softness = p.min2 = 0;
+    p.switch2 = p.switchNorm = 0;
+    if(list.size() == 1 && list[0].kind != PairPotential::ScreenedCoulomb)
+    {
+        const PairPotential &term = list[0];
+        p.kernel = term.kind == PairPotential::LennardJones ? LennardJonesKernel : SoftCoreKernel;
+        p.epsilon4 = 4 * term.epsilon;
+        p.sigma2 = term.sigma * term.sigma;
+        p.softness = term.softness;
+        p.min2 = term.minDistance * term.minDistance;
+        p.cut2 = term.cutoff * term.cutoff;
+        p.switch2 = term.switchStart * term.switchStart;
+        double width = p.cut2 - p.switch2;
+        p.switchNorm = width > 0 ? 1 / (width * width * width) : 0;
+    }
+
+    matrix[b * types + a] = p;
+}
+
+double PairPotentials::maxCutoff() const
+{
+    double cut2 = 0;
+    for(size_t i = 0; i < matrix.size(); i++)
+    {
+        if(matrix[i].cut2 > cut2)
+            cut2 = matrix[i].cut2;
+        if(matrix[i].reaction2 > cut2)
+            cut2 = matrix[i].reaction2;
+    }
+    return sqrt(cut2);
+}
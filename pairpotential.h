@@ -0,0 +1,180 @@
+#ifndef PAIRPOTENTIAL_H
+#define PAIRPOTENTIAL_H
+
+#include <vector>
+
+// Um termo de interacao entre dois elementos. Os parametros valem so para
+// o tipo escolhido; as funcoes estaticas montam cada um.
+struct PairPotential
+{
+    enum Kind { LennardJones, SoftCore, ScreenedCoulomb };
+    int kind;
+    double epsilon;     // poco do LJ/soft-core, ou k*qA*qB no Coulomb
+    double sigma;
+    double softness;    // alpha do soft-core: 0 e o LJ, maior e mais mole
+    double screening;   // kappa do Coulomb blindado, 1/comprimento
+    double minDistance; // abaixo disso a tabela repete o primeiro valor
+    double cutoff;
+    double switchStart; // o termo vai a zero suavemente entre aqui e o cutoff
+
+    static PairPotential lennardJones(double epsilon, double sigma, double cutoff);
+    static PairPotential softCore(double epsilon, double sigma, double softness, double cutoff);
+    static PairPotential screenedCoulomb(double strength, double screening,
+                                         double minDistance, double cutoff);
+};
+
+// Soma dos termos de um par, tabelada em r^2. Cada amostra guarda a
+// energia e a forca dividida por r, entao o laco interno so interpola:
+// nada de sqrt, exp ou pow por par.
+class PairTable
+{
+public:
+    PairTable();
+
+    void clear();
+    void addTerm(const PairPotential &term);
+    void build(int samples = 2048);
+    bool isEmpty() const { return terms.empty(); }
+    double cutoff() const;
+
+    // false fora do corte; forceOverR > 0 empurra os atomos para longe
+    bool evaluate(double r2, double &forceOverR, double &energy) const
+    {
+        if(r2 >= cut2)
+            return false;
+        double s = (r2 - start2) * invStep;
+        if(s < 0)
+            s = 0;
+        // perto do corte o arredondamento pode dar k = samples; a ultima
+        // amostra e o fim do intervalo, entao interpola com t = 1
+        int k = (int)s;
+        if(k > lastSample)
+            k = lastSample;
+        double t = s - k;
+        const double *v = &values[2 * k];
+        energy = v[0] + t * (v[2] - v[0]);
+        forceOverR = v[1] + t * (v[3] - v[1]);
+        return true;
+    }
+
+private:
+    std::vector<PairPotential> terms;
+    double start2;
+    double cut2;
+    double invStep;
+    int lastSample;             // samples - 1: o ultimo k que tem k + 1
+    std::vector<double> values; // energia, forca/r de cada amostra
+
+    void sample(double r2, double &forceOverR, double &energy) const;
+};
+
+// Como o laco interno avalia um par. Um termo so de LJ ou de soft-core
+// e conta direta em r^2; o resto (Coulomb, somas) vai pela tabela.
+enum PairKernelKind { TabulatedKernel, LennardJonesKernel, SoftCoreKernel, PairKernelCount };
+
+// Tudo o que o laco interno precisa de um par de elementos, montado uma
+// vez a partir da tabela de elementos e dos termos.
+struct PairParams
+{
+    int kernel;
+    double contact2;    // (rA + rB + margem)^2, para o sono
+    double touch2;      // (rA + rB)^2: dai para dentro, no modo rigido, so o choque
+    double reaction2;   // 0 se o par nao reage
+    double cut2;
+
+    // termo analitico (LJ ou soft-core) ja com o corte suave
+    double epsilon4;
+    double sigma2;
+    double softness;
+    double min2;
+    double switch2;
+    double switchNorm;
+
+    PairTable table;
+};
+
+// O switch do CHARMM em r^2, o mesmo usado para montar as tabelas.
+inline void applySwitch(const PairParams &p, double r2, double &forceOverR, double &energy)
+{
+    if(r2 <= p.switch2)
+        return;
+    double a = p.cut2 - r2;
+    double s = a * a * (p.cut2 + 2 * r2 - 3 * p.switch2) * p.switchNorm;
+    double ds = 6 * a * (p.switch2 - r2) * p.switchNorm;
+    forceOverR = forceOverR * s - 2 * energy * ds;
+    energy *= s;
+}
+
+// Um kernel por tipo de potencial, escolhido em tempo de compilacao: o
+// laco de cada tipo so faz a conta dele, sem perguntar o tipo por par.
+template <int Kind> struct PairKernel;
+
+template <> struct PairKernel<TabulatedKernel>
+{
+    static bool evaluate(const PairParams &p, double r2, double &forceOverR, double &energy)
+    {
+        return p.table.evaluate(r2, forceOverR, energy);
+    }
+};
+
+template <> struct PairKernel<LennardJonesKernel>
+{
+    static bool evaluate(const PairParams &p, double r2, double &forceOverR, double &energy)
+    {
+        if(r2 >= p.cut2)
+            return false;
+        double r2c = r2 < p.min2 ? p.min2 : r2;
+        double x = p.sigma2 / r2c;
+        double x3 = x * x * x;
+        double x6 = x3 * x3;
+        energy = p.epsilon4 * (x6 - x3);
+        forceOverR = 6 * p.epsilon4 * (2 * x6 - x3) / r2c;
+        applySwitch(p, r2c, forceOverR, energy);
+        return true;
+    }
+};
+
+template <> struct PairKernel<SoftCoreKernel>
+{
+    static bool evaluate(const PairParams &p, double r2, double &forceOverR, double &energy)
+    {
+        if(r2 >= p.cut2)
+            return false;
+        double x = r2 / p.sigma2;
+        double y = x * x * x;
+        double inv = 1 / (p.softness + y);
+        energy = p.epsilon4 * (inv * inv - inv);
+        double dudy = p.epsilon4 * (inv * inv - 2 * inv * inv * inv);
+        forceOverR = -6 * dudy * x * x / p.sigma2;
+        applySwitch(p, r2, forceOverR, energy);
+        return true;
+    }
+};
+
+// Matriz densa de PairParams, simetrica, indexada pelo tipo (posicao na
+// tabela de elementos) dos dois atomos.
+class PairPotentials
+{
+public:
+    PairPotentials();
+
+    void loadDefaults();
+    void set(int elementA, int elementB, const PairPotential &term);
+    void add(int elementA, int elementB, const PairPotential &term);
+    void setReaction(int elementA, int elementB, double distance);
+    void setContactMargin(double margin);
+    double maxCutoff() const;
+
+    const PairParams &params(int typeA, int typeB) const { return matrix[typeA * types + typeB]; }
+
+private:
+    int types;
+    double contactMargin;
+    std::vector<PairParams> matrix;
+    std::vector<std::vector<PairPotential> > terms;
+
+    void pairTypes(int elementA, int elementB, int &a, int &b) const;
+    void rebuild(int a, int b);
+};
+
+#endif // PAIRPOTENTIAL_H
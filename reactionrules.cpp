@@ -0,0 +1,30 @@
+#include "reactionrules.h"
+
+namespace {
+
+// Kw = kb [H2O] / kf = 1e-14 a 25 C
+const double Neutralization = 1.4e11;
+const double Autoionization = 1e-14 * Neutralization / WaterMolar;
+
+const ReactionRule rules[] =
+{
+    // H-Cl + F -> H-F + Cl, quando o H chega a 40 do F
+    { { "HCl", "F" }, { "HF", "Cl" }, 0, 1, 9, 40 },
+    // a agua em volta
+    { { "H+", "OH-" }, { "H2O", 0 }, Neutralization, 0, 0, 0 },
+    { { "H2O", 0 }, { "H+", "OH-" }, Autoionization, 0, 0, 0 }
+};
+
+const int ruleCount = sizeof(rules) / sizeof(rules[0]);
+
+}
+
+int reactionRuleCount()
+{
+    return ruleCount;
+}
+
+const ReactionRule &reactionRule(int i)
+{
+    return rules[i];
+}
@@ -0,0 +1,29 @@
+#ifndef REACTIONRULES_H
+#define REACTIONRULES_H
+
+// As reacoes da cena numa tabela so, lida pelos dois motores:
+//
+//   - a matriz de pares (PairPotentials::loadDefaults) pega as regras de
+//     contato, com elementA/elementB e distance: o atomo elementA de uma
+//     molecula encosta no elementB de outra e as ligacoes trocam
+//   - a StochasticKinetics da BulkSolution pega as regras com rate, pelas
+//     especies em reactants/products
+//
+// Uma regra pode ter as duas partes; hoje cada uma so usa uma. O nome das
+// especies e o mesmo de molecularFormula(), com a carga no fim.
+struct ReactionRule
+{
+    const char *reactants[2];   // 0 = nenhum
+    const char *products[2];
+    double rate;                // 1/s ou 1/(M s); 0 = nao e da cinetica
+    int elementA, elementB;     // numeros atomicos; 0 = nao e de contato
+    double distance;
+};
+
+// a agua pura, mol/L; entra no Kw das regras da solucao
+const double WaterMolar = 55.5;
+
+int reactionRuleCount();
+const ReactionRule &reactionRule(int i);
+
+#endif // REACTIONRULES_H
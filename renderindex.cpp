@@ -0,0 +1,88 @@
+#include "renderindex.h"
+
+#include <math.h>
+
+RenderIndex::RenderIndex()
+    : cellSize(100), originX(0), originY(0), nx(0), ny(0)
+{
+}
+
+// Fora da caixa (so sem periodico) vai para a celula da borda: a
+// consulta limita as celulas a grade, entao quem esta fora ainda aparece
+// quando a tela passa da borda.
+static int cellIndex(double offset, double size, double cell, int count, bool periodic)
+{
+    if(periodic)
+        offset -= size * floor(offset / size);
+    int c = (int)floor(offset / cell);
+    return qMax(0, qMin(count - 1, c));
+}
+
+void RenderIndex::build(const std::vector<double> &x, const std::vector<double> &y, const SimBox &box)
+{
+    originX = box.left;
+    originY = box.top;
+    nx = qMax(1, (int)ceil(box.width / cellSize));
+    ny = qMax(1, (int)ceil(box.height / cellSize));
+
+    int n = (int)x.size();
+    itemCell.resize(n);
+    for(int i = 0; i < n; i++)
+    {
+        int cx = cellIndex(x[i] - originX, box.width, cellSize, nx, box.periodic);
+        int cy = cellIndex(y[i] - originY, box.height, cellSize, ny, box.periodic);
+        itemCell[i] = cy * nx + cx;
+    }
+    sortByCell();
+}
+
+void RenderIndex::build(const RenderIndex &owners, const std::vector<int> &owner)
+{
+    cellSize = owners.cellSize;
+    originX = owners.originX;
+    originY = owners.originY;
+    nx = owners.nx;
+    ny = owners.ny;
+
+    int n = (int)owner.size();
+    itemCell.resize(n);
+    for(int i = 0; i < n; i++)
+        itemCell[i] = owners.itemCell[owner[i]];
+    sortByCell();
+}
+
+void RenderIndex::sortByCell()
+{
+    int n = (int)itemCell.size();
+    cellStart.assign(nx * ny + 1, 0);
+    items.resize(n);
+    for(int i = 0; i < n; i++)
+        cellStart[itemCell[i] + 1]++;
+    for(int c = 0; c < nx * ny; c++)
+        cellStart[c + 1] += cellStart[c];
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for(int i = 0; i < n; i++)
+        items[fill[itemCell[i]]++] = i;
+}
+
+void RenderIndex::query(const QRectF &rect, QVector<int> &out) const
+{
+    out.clear();
+    if(nx == 0 || ny == 0)
+        return;
+
+    int x0 = cellIndex(rect.left() - originX, 0, cellSize, nx, false);
+    int x1 = cellIndex(rect.right() - originX, 0, cellSize, nx, false);
+    int y0 = cellIndex(rect.top() - originY, 0, cellSize, ny, false);
+    int y1 = cellIndex(rect.bottom() - originY, 0, cellSize, ny, false);
+
+    for(int cy = y0; cy <= y1; cy++)
+    {
+        for(int cx = x0; cx <= x1; cx++)
+        {
+            int c = cy * nx + cx;
+            for(int k = cellStart[c]; k < cellStart[c + 1]; k++)
+                out << items[k];
+        }
+    }
+}
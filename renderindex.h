@@ -0,0 +1,43 @@
+#ifndef RENDERINDEX_H
+#define RENDERINDEX_H
+
+#include <QRectF>
+#include <QVector>
+#include <vector>
+
+#include "simtypes.h"
+
+// Indice espacial do lado do desenho: uma grade uniforme em CSR sobre a
+// caixa, refeita a cada quadro direto das coordenadas do quadro, para
+// achar so o que cai na area visivel. Substitui o indice da
+// QGraphicsScene, que nao compensa com itens que andam todo quadro.
+//
+// Montar so conta celulas (a volta na caixa entra na conta da celula);
+// dar a volta de verdade, calcular ligacoes e mexer em itens fica para
+// o que a consulta devolver.
+class RenderIndex
+{
+public:
+    RenderIndex();
+
+    void setCellSize(qreal size) { cellSize = size; }
+    void build(const std::vector<double> &x, const std::vector<double> &y, const SimBox &box);
+    // cada item na celula de um item de outro indice (ligacao -> atomo)
+    void build(const RenderIndex &owners, const std::vector<int> &owner);
+
+    // tudo que esta nas celulas que o retangulo toca: pode sobrar, o
+    // teste fino e de quem chama
+    void query(const QRectF &rect, QVector<int> &out) const;
+
+private:
+    qreal cellSize;
+    qreal originX, originY;
+    int nx, ny;
+    std::vector<int> cellStart;
+    std::vector<int> items;
+    std::vector<int> itemCell;
+
+    void sortByCell();
+};
+
+#endif // RENDERINDEX_H
@@ -0,0 +1,162 @@
+#ifndef SIMTYPES_H
+#define SIMTYPES_H
+
+#include <vector>
+#include <math.h>
+
+// Bytes reservados por um vetor, para os relatorios de memoria.
+template <typename T>
+inline size_t vectorBytes(const std::vector<T> &v)
+{
+    return v.capacity() * sizeof(T);
+}
+
+// Estado da fisica separado dos QGraphicsItem, para poder rodar em outra
+// thread. Raio e massa sao do elemento: ficam numa tabela por tipo, fora
+// do atomo. No modo rigido cada atomo guarda a posicao no referencial da
+// molecula (body) e a posicao na cena e recalculada a partir da posicao e
+// do angulo da molecula. No modo flexivel cada atomo tem a sua velocidade
+// e as ligacoes sao molas.
+
+struct SimAtom
+{
+    int element;
+    int type;       // posicao na tabela de elementos
+    int molecule;
+    double bodyX, bodyY;
+    double x, y;
+    double vx, vy;  // so no modo flexivel
+};
+
+// A molecula e derivada das ligacoes: um componente conexo do grafo.
+// O corpo rigido gira em torno do centro de massa.
+struct SimMolecule
+{
+    double x, y;    // centro de massa
+    double vx, vy;
+    double angle;   // graus, como no QGraphicsItem::setRotation
+    double angular; // graus por passo
+    double mass;
+    double inertia;
+    std::vector<int> members;
+    int restSteps;  // passos seguidos quase parada
+    bool asleep;
+};
+
+struct SimBond
+{
+    int a, b;
+    bool visible;
+    double restLength;
+};
+
+// A caixa da simulacao. Com paredes os atomos quicam; no modo periodico
+// quem sai de um lado entra do outro e as distancias usam a menor imagem.
+struct SimBox
+{
+    double left, top, width, height;
+    bool periodic;
+
+    void minimumImage(double &dx, double &dy) const
+    {
+        if(!periodic)
+            return;
+        dx -= width * floor(dx / width + 0.5);
+        dy -= height * floor(dy / height + 0.5);
+    }
+
+    // no modo periodico, a imagem do ponto dentro da caixa
+    void wrap(double &x, double &y) const
+    {
+        if(!periodic)
+            return;
+        x -= width * floor((x - left) / width);
+        y -= height * floor((y - top) / height);
+    }
+};
+
+// Como montar a cena: o H-Cl + F de sempre, numa caixa do tamanho pedido,
+// mais pares H-Cl + F espalhados ao acaso. Com encounter a cena de
+// sempre vira um encontro montado: o H-Cl vem em linha reta contra um F
+// parado, com o eixo H-Cl girado de approachAngle (0 = H na frente).
+// Velocidade e distancia zero valem como qualquer outro valor: quem
+// liga o encontro e a distancia sao as flags, nao o valor.
+struct Scenario
+{
+    double worldSize;   // 0 = caixa padrao
+    int extraPairs;
+    unsigned seed;
+    bool encounter;
+    double approachSpeed;
+    double approachAngle;   // graus
+    double approachSpin;    // graus por passo
+    bool customReaction;    // false = a distancia da matriz de pares
+    double reactionDistance;
+    double solutionPH;      // 0 = sem solucao em volta (BulkSolution)
+    int thermostat;         // Thermostat::Kind
+    double targetTemperature; // 0 = a da cena montada
+
+    Scenario()
+        : worldSize(0), extraPairs(0), seed(1),
+          encounter(false), approachSpeed(0), approachAngle(0), approachSpin(0),
+          customReaction(false), reactionDistance(0),
+          solutionPH(0), thermostat(0), targetTemperature(0) {}
+};
+
+// Comandos do teclado, aplicados entre um passo e outro.
+struct SimCommand
+{
+    enum Kind { Push, SetFlexible, SetPeriodic, SetSleep, Titrate, SetThermostat };
+    int kind;
+    int atom;       // age na molecula que contem este atomo
+                    // SetThermostat: o Thermostat::Kind
+    bool flag;      // Titrate: true = acido, false = base
+    double dvx, dvy; // Titrate: dvx em mol/L; SetThermostat: dvx e o alvo
+    double dAngular;
+};
+
+// Contadores para acompanhar o custo da fisica.
+struct SimStats
+{
+    unsigned long long steps;
+    unsigned long long neighborRebuilds;
+    int neighborPairs;
+    int awakeMolecules;
+    int sleepingMolecules;
+    double potentialEnergy;
+    double kineticEnergy;
+    double temperature;
+    int reactions;
+    unsigned long long memoryBytes;
+    double pH;              // 0 = sem solucao
+    double ionsPerMarker;
+    int thermostat;         // Thermostat::Kind
+    double targetTemperature;
+
+    // zerado: a janela desenha a barra antes do primeiro quadro chegar
+    SimStats()
+        : steps(0), neighborRebuilds(0), neighborPairs(0), awakeMolecules(0),
+          sleepingMolecules(0), potentialEnergy(0), kineticEnergy(0), temperature(0),
+          reactions(0), memoryBytes(0), pH(0), ionsPerMarker(0), thermostat(0),
+          targetTemperature(0) {}
+};
+
+// O que a janela precisa para desenhar um passo. Os marcadores da
+// BulkSolution vem no fim dos atomos e das ligacoes: solutionAtoms e
+// solutionBonds dizem quantos, para quem mede so as moleculas.
+struct SimFrame
+{
+    unsigned long long step;
+    SimStats stats;
+    SimBox box;
+    std::vector<double> x, y;
+    std::vector<int> element;
+    std::vector<int> bondA, bondB;
+    std::vector<char> bondVisible;
+    size_t solutionAtoms;
+    size_t solutionBonds;
+
+    SimFrame() : step(0), solutionAtoms(0), solutionBonds(0) {}
+};
+
+#endif // SIMTYPES_H
@@ -0,0 +1,1411 @@
+#include "simulation.h"
+#include "elements.h"
+#include "trace.h"
+
+#include <math.h>
+#include <random>
+#include <algorithm>
+
+static const double Pi = 3.14159265358979323846264338327950288419717;
+
+// as paredes ficam um pouco para dentro da caixa
+static const double WallMargin = 10;
+// a mola da parede no modo flexivel; com o H (massa 1) a oscilacao fica
+// bem abaixo do limite de estabilidade do passo
+static const double WallStiffness = 0.5;
+
+Simulation::Simulation()
+    : stepCount(0),
+      visitEpoch(0),
+      potentialEnergy(0),
+      sleepEnabled(true), sleepSpeed(0.02), sleepSpin(0.1), sleepDelay(30),
+      contactMargin(10), wakeRadius(100),
+      flexible(false), bondStiffness(0.2), angleStiffness(0.05), breakEnergy(600),
+      reaction(false), reactionCount(0),
+      restitution(1), contactIterations(8)
+{
+    box.left = -250;
+    box.top = -250;
+    box.width = 490;
+    box.height = 490;
+    box.periodic = false;
+
+    for(int type = 0; type < elementTypeCount(); type++)
+    {
+        typeMass.push_back(elementInfoByType(type).mass);
+        typeRadius.push_back(elementInfoByType(type).radius);
+    }
+
+    pairs.setContactMargin(contactMargin);
+    pairs.loadDefaults();
+    updateCutoff();
+}
+
+void Simulation::setPairPotential(int elementA, int elementB, const PairPotential &term)
+{
+    pairs.set(elementA, elementB, term);
+    updateCutoff();
+}
+
+void Simulation::addPairPotential(int elementA, int elementB, const PairPotential &term)
+{
+    pairs.add(elementA, elementB, term);
+    updateCutoff();
+}
+
+void Simulation::setReaction(int elementA, int elementB, double distance)
+{
+    pairs.setReaction(elementA, elementB, distance);
+    updateCutoff();
+}
+
+// A lista de vizinhos cobre o maior corte e a maior distancia de reacao.
+// Mudar o corte invalida a lista, e os pares sao separados de novo.
+void Simulation::updateCutoff()
+{
+    neighbors.setCutoff(pairs.maxCutoff());
+}
+
+void Simulation::setBox(double left, double top, double width, double height)
+{
+    box.left = left;
+    box.top = top;
+    box.width = width;
+    box.height = height;
+}
+
+void Simulation::setPeriodic(bool on)
+{
+    if(on == box.periodic)
+        return;
+
+    box.periodic = on;
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        if(!molecules[m].members.empty())
+            wrapMolecule((int)m);
+    }
+    neighbors.invalidate();
+    wakeAll();
+}
+
+int Simulation::addAtom(int element, double x, double y)
+{
+    SimAtom atom;
+    atom.element = element;
+    atom.type = elementType(element);
+    atom.molecule = newMolecule();
+    atom.bodyX = atom.bodyY = 0;
+    atom.x = x;
+    atom.y = y;
+    atom.vx = atom.vy = 0;
+    atoms.push_back(atom);
+
+    int index = (int)atoms.size() - 1;
+    atomBonds.push_back(std::vector<int>());
+    visitMark.push_back(0);
+    components.add();
+    molecules[atom.molecule].members.push_back(index);
+    rebuildBody(atom.molecule);
+    neighbors.invalidate();
+    return index;
+}
+
+int Simulation::formBond(int a, int b)
+{
+    double dx = atoms[b].x - atoms[a].x;
+    double dy = atoms[b].y - atoms[a].y;
+    box.minimumImage(dx, dy);
+
+    SimBond bond;
+    bond.a = a;
+    bond.b = b;
+    bond.visible = true;
+    bond.restLength = sqrt(dx * dx + dy * dy);
+
+    int index;
+    if(!freeBonds.empty())
+    {
+        index = freeBonds.back();
+        freeBonds.pop_back();
+        bonds[index] = bond;
+    }
+    else
+    {
+        bonds.push_back(bond);
+        index = (int)bonds.size() - 1;
+    }
+    atomBonds[a].push_back(index);
+    atomBonds[b].push_back(index);
+    topology.invalidate();
+
+    // ja estavam na mesma molecula: fechou um anel, nada a reagrupar
+    if(components.find(a) != components.find(b))
+    {
+        mergeMolecules(a, b);
+        components.unite(a, b);
+    }
+    return index;
+}
+
+void Simulation::breakBond(int bond)
+{
+    if(!bonds[bond].visible)
+        return;
+
+    int a = bonds[bond].a;
+    int b = bonds[bond].b;
+    bonds[bond].visible = false;
+    for(int k = 0; k < 2; k++)
+    {
+        std::vector<int> &list = atomBonds[k == 0 ? a : b];
+        for(size_t i = 0; i < list.size(); i++)
+        {
+            if(list[i] == bond)
+            {
+                list[i] = list.back();
+                list.pop_back();
+                break;
+            }
+        }
+    }
+    freeBonds.push_back(bond);
+    topology.invalidate();
+
+    splitIfDisconnected(a, b);
+}
+
+void Simulation::setMoleculeVelocity(int molecule, double vx, double vy, double angular)
+{
+    molecules[molecule].vx = vx;
+    molecules[molecule].vy = vy;
+    molecules[molecule].angular = angular;
+    wakeMolecule(molecule);
+}
+
+void Simulation::loadDefaultScene()
+{
+    int hydrogen = addAtom(1, -150, 0);
+    int chlorine = addAtom(17, -100, 0);
+    int fluorine = addAtom(9, 100, -100);
+    formBond(hydrogen, chlorine);
+
+    setMoleculeVelocity(moleculeOf(hydrogen), 0.1, 3, 3);
+    setMoleculeVelocity(moleculeOf(fluorine), 1, 2, 0);
+
+    reaction = true;
+}
+
+// H-Cl a esquerda indo para a direita, F parado a 200 de distancia.
+void Simulation::loadEncounter(double speed, double angle, double spin)
+{
+    double length = 50;
+    double a = angle * Pi / 180;
+    double mh = elementInfo(1).mass;
+    double mcl = elementInfo(17).mass;
+    // H a frente do centro de massa quando angle = 0
+    double dh = length * mcl / (mh + mcl);
+    double dcl = length - dh;
+    double cx = -100, cy = 0;
+    int hydrogen = addAtom(1, cx + dh * cos(a), cy + dh * sin(a));
+    int chlorine = addAtom(17, cx - dcl * cos(a), cy - dcl * sin(a));
+    addAtom(9, 100, 0);
+    formBond(hydrogen, chlorine);
+
+    setMoleculeVelocity(moleculeOf(hydrogen), speed, 0, spin);
+    reaction = true;
+}
+
+void Simulation::shiftMolecule(int molecule, double dx, double dy)
+{
+    SimMolecule &mol = molecules[molecule];
+    mol.x += dx;
+    mol.y += dy;
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        atoms[mol.members[i]].x += dx;
+        atoms[mol.members[i]].y += dy;
+    }
+}
+
+// A molecula inteira passa para o outro lado quando o centro de massa sai
+// da caixa; os atomos dela continuam juntos.
+void Simulation::wrapMolecule(int molecule)
+{
+    const SimMolecule &mol = molecules[molecule];
+    double dx = 0, dy = 0;
+    if(mol.x < box.left)
+        dx = box.width;
+    else if(mol.x >= box.left + box.width)
+        dx = -box.width;
+    if(mol.y < box.top)
+        dy = box.height;
+    else if(mol.y >= box.top + box.height)
+        dy = -box.height;
+    if(dx != 0 || dy != 0)
+        shiftMolecule(molecule, dx, dy);
+}
+
+void Simulation::loadScenario(const Scenario &scenario)
+{
+    if(scenario.worldSize > 0)
+        setBox(-scenario.worldSize / 2, -scenario.worldSize / 2,
+               scenario.worldSize, scenario.worldSize);
+    if(scenario.customReaction)
+        setReaction(1, 9, scenario.reactionDistance);
+    if(scenario.encounter)
+        loadEncounter(scenario.approachSpeed, scenario.approachAngle, scenario.approachSpin);
+    else
+        loadDefaultScene();
+
+    std::mt19937 random(scenario.seed);
+    std::uniform_real_distribution<double> px(box.left + 40, box.left + box.width - 40);
+    std::uniform_real_distribution<double> py(box.top + 40, box.top + box.height - 40);
+    std::uniform_real_distribution<double> speed(-2, 2);
+    std::uniform_real_distribution<double> spin(-3, 3);
+    for(int i = 0; i < scenario.extraPairs; i++)
+    {
+        double x = px(random);
+        double y = py(random);
+        int h = addAtom(1, x - 25, y);
+        int cl = addAtom(17, x + 25, y);
+        formBond(h, cl);
+        setMoleculeVelocity(moleculeOf(h), speed(random), speed(random), spin(random));
+
+        int f = addAtom(9, px(random), py(random));
+        setMoleculeVelocity(moleculeOf(f), speed(random), speed(random), 0);
+    }
+
+    if(scenario.solutionPH > 0)
+        solution.setup(scenario.solutionPH, box, scenario.seed);
+
+    thermostat.seed(scenario.seed);
+    setThermostat(scenario.thermostat, scenario.targetTemperature);
+}
+
+int Simulation::newMolecule()
+{
+    SimMolecule mol;
+    mol.x = mol.y = 0;
+    mol.vx = mol.vy = 0;
+    mol.angle = mol.angular = 0;
+    mol.mass = mol.inertia = 0;
+    mol.restSteps = 0;
+    mol.asleep = false;
+
+    if(!freeMolecules.empty())
+    {
+        int index = freeMolecules.back();
+        freeMolecules.pop_back();
+        molecules[index] = mol;
+        return index;
+    }
+    molecules.push_back(mol);
+    return (int)molecules.size() - 1;
+}
+
+// Junta a molecula menor na maior. So os atomos das duas sao tocados.
+void Simulation::mergeMolecules(int atomA, int atomB)
+{
+    int a = atoms[atomA].molecule;
+    int b = atoms[atomB].molecule;
+
+    // no modo periodico a molecula de b vem para a imagem mais perto de a,
+    // para a molecula nova ficar inteira
+    double dx = atoms[atomB].x - atoms[atomA].x;
+    double dy = atoms[atomB].y - atoms[atomA].y;
+    double ix = dx, iy = dy;
+    box.minimumImage(ix, iy);
+    if(ix != dx || iy != dy)
+        shiftMolecule(b, ix - dx, iy - dy);
+
+    materializeVelocities(a);
+    materializeVelocities(b);
+
+    int keep = a;
+    int gone = b;
+    if(molecules[b].members.size() > molecules[a].members.size())
+    {
+        keep = b;
+        gone = a;
+    }
+
+    std::vector<int> &members = molecules[gone].members;
+    for(size_t i = 0; i < members.size(); i++)
+    {
+        atoms[members[i]].molecule = keep;
+        molecules[keep].members.push_back(members[i]);
+    }
+    members.clear();
+    freeMolecules.push_back(gone);
+
+    rebuildBody(keep);
+    wakeMolecule(keep);
+    neighbors.invalidate();
+}
+
+// Depois de quebrar a-b: se b nao e mais alcancavel a partir de a, o
+// pedaco de b vira uma molecula nova. A busca so anda pela molecula
+// afetada.
+void Simulation::splitIfDisconnected(int a, int b)
+{
+    std::vector<int> sideA;
+    collectComponent(a, sideA);
+    if(visitMark[b] == visitEpoch)
+        return;
+
+    int old = atoms[a].molecule;
+    materializeVelocities(old);
+
+    std::vector<int> sideB;
+    collectComponent(b, sideB);
+    int created = newMolecule();
+
+    molecules[old].members = sideA;
+    molecules[created].members = sideB;
+    components.reset(a);
+    for(size_t i = 0; i < sideA.size(); i++)
+    {
+        if(sideA[i] != a)
+            components.attach(sideA[i], a);
+    }
+    components.reset(b);
+    for(size_t i = 0; i < sideB.size(); i++)
+    {
+        atoms[sideB[i]].molecule = created;
+        if(sideB[i] != b)
+            components.attach(sideB[i], b);
+    }
+
+    rebuildBody(old);
+    rebuildBody(created);
+    wakeMolecule(old);
+    neighbors.invalidate();
+}
+
+void Simulation::collectComponent(int start, std::vector<int> &out)
+{
+    visitEpoch++;
+    out.clear();
+    out.push_back(start);
+    visitMark[start] = visitEpoch;
+    for(size_t k = 0; k < out.size(); k++)
+    {
+        const std::vector<int> &list = atomBonds[out[k]];
+        for(size_t i = 0; i < list.size(); i++)
+        {
+            const SimBond &bond = bonds[list[i]];
+            int other = bond.a == out[k] ? bond.b : bond.a;
+            if(visitMark[other] == visitEpoch)
+                continue;
+            visitMark[other] = visitEpoch;
+            out.push_back(other);
+        }
+    }
+}
+
+// No modo rigido a velocidade de cada atomo e a do corpo naquele ponto.
+void Simulation::materializeVelocities(int molecule)
+{
+    if(flexible)
+        return;
+
+    const SimMolecule &mol = molecules[molecule];
+    double w = mol.angular * Pi / 180;
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        SimAtom &atom = atoms[mol.members[i]];
+        atom.vx = mol.vx - w * (atom.y - mol.y);
+        atom.vy = mol.vy + w * (atom.x - mol.x);
+    }
+}
+
+// Centro de massa, inercia e posicoes no referencial do corpo, a partir
+// das posicoes e velocidades dos atomos. Conserva momento linear e
+// angular. O referencial novo comeca alinhado com a cena.
+void Simulation::rebuildBody(int molecule)
+{
+    SimMolecule &mol = molecules[molecule];
+    double mass = 0, cx = 0, cy = 0, px = 0, py = 0;
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        const SimAtom &atom = atoms[mol.members[i]];
+        double m = massOf(atom);
+        mass += m;
+        cx += m * atom.x;
+        cy += m * atom.y;
+        px += m * atom.vx;
+        py += m * atom.vy;
+    }
+    if(mass <= 0)
+        return;
+    cx /= mass;
+    cy /= mass;
+
+    double inertia = 0, spin = 0;
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        SimAtom &atom = atoms[mol.members[i]];
+        double rx = atom.x - cx;
+        double ry = atom.y - cy;
+        double m = massOf(atom);
+        inertia += m * (rx * rx + ry * ry);
+        spin += m * (rx * atom.vy - ry * atom.vx);
+        atom.bodyX = rx;
+        atom.bodyY = ry;
+    }
+
+    mol.x = cx;
+    mol.y = cy;
+    mol.vx = px / mass;
+    mol.vy = py / mass;
+    mol.mass = mass;
+    mol.inertia = inertia;
+    mol.angle = 0;
+    mol.angular = inertia > 1e-9 ? spin / inertia * 180 / Pi : 0;
+}
+
+void Simulation::setFlexible(bool on)
+{
+    if(on == flexible)
+        return;
+
+    // cada atomo herda a velocidade do corpo rigido naquele ponto, e na
+    // volta o corpo rigido e refeito a partir dos atomos
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        if(molecules[m].members.empty())
+            continue;
+        if(on)
+            materializeVelocities((int)m);
+        else
+            rebuildBody((int)m);
+    }
+    topology.invalidate();
+    flexible = on;
+    wakeAll();
+}
+
+void Simulation::setSleepEnabled(bool on)
+{
+    sleepEnabled = on;
+    if(!on)
+        wakeAll();
+}
+
+void Simulation::wakeMolecule(int molecule)
+{
+    molecules[molecule].asleep = false;
+    molecules[molecule].restSteps = 0;
+}
+
+void Simulation::wakeAll()
+{
+    for(size_t m = 0; m < molecules.size(); m++)
+        wakeMolecule((int)m);
+}
+
+// Acorda quem esta dormindo perto de (x, y), por exemplo de uma reacao.
+void Simulation::wakeNear(double x, double y)
+{
+    double limit = wakeRadius * wakeRadius;
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        const SimMolecule &mol = molecules[m];
+        if(!mol.asleep)
+            continue;
+        double dx = mol.x - x;
+        double dy = mol.y - y;
+        box.minimumImage(dx, dy);
+        if(dx * dx + dy * dy < limit)
+            wakeMolecule((int)m);
+    }
+}
+
+bool Simulation::isResting(int molecule) const
+{
+    const SimMolecule &mol = molecules[molecule];
+    double limit = sleepSpeed * sleepSpeed;
+    if(!flexible)
+        return (mol.vx * mol.vx + mol.vy * mol.vy < limit) &&
+                (fabs(mol.angular) < sleepSpin);
+
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        const SimAtom &atom = atoms[mol.members[i]];
+        if(atom.vx * atom.vx + atom.vy * atom.vy >= limit)
+            return false;
+    }
+    return true;
+}
+
+// Cada molecula comeca sozinha na sua ilha; os contatos do passo juntam.
+void Simulation::resetIslands()
+{
+    while(islands.count() < (int)molecules.size())
+        islands.add();
+    for(size_t m = 0; m < molecules.size(); m++)
+        islands.reset((int)m);
+}
+
+// Dois atomos de moleculas diferentes se encostando. Quem esta agitado
+// acorda quem dorme; dois acordados ficam na mesma ilha.
+void Simulation::contact(int atomA, int atomB)
+{
+    if(!sleepEnabled)
+        return;
+
+    int a = atoms[atomA].molecule;
+    int b = atoms[atomB].molecule;
+    if(molecules[a].asleep && molecules[b].restSteps < sleepDelay)
+        wakeMolecule(a);
+    if(molecules[b].asleep && molecules[a].restSteps < sleepDelay)
+        wakeMolecule(b);
+    if(!molecules[a].asleep && !molecules[b].asleep)
+        islands.unite(a, b);
+}
+
+// Uma ilha inteira dorme quando todas as moleculas dela passaram
+// sleepDelay passos quase paradas. Dormindo, a velocidade vai a zero.
+void Simulation::updateSleep()
+{
+    TRACE_ZONE("updateSleep");
+    int count = (int)molecules.size();
+    // a reacao pode ter criado moleculas depois dos contatos
+    while(islands.count() < count)
+        islands.add();
+
+    for(int m = 0; m < count; m++)
+    {
+        SimMolecule &mol = molecules[m];
+        if(mol.members.empty() || mol.asleep)
+            continue;
+        mol.restSteps = isResting(m) ? mol.restSteps + 1 : 0;
+    }
+
+    islandReady.assign(count, 1);
+    for(int m = 0; m < count; m++)
+    {
+        const SimMolecule &mol = molecules[m];
+        if(!mol.members.empty() && !mol.asleep && mol.restSteps < sleepDelay)
+            islandReady[islands.find(m)] = 0;
+    }
+
+    for(int m = 0; m < count; m++)
+    {
+        SimMolecule &mol = molecules[m];
+        if(mol.members.empty() || mol.asleep || !islandReady[islands.find(m)])
+            continue;
+        mol.asleep = true;
+        mol.vx = mol.vy = mol.angular = 0;
+        for(size_t i = 0; i < mol.members.size(); i++)
+            atoms[mol.members[i]].vx = atoms[mol.members[i]].vy = 0;
+    }
+}
+
+void Simulation::apply(const SimCommand &command)
+{
+    if(command.kind == SimCommand::SetFlexible)
+    {
+        setFlexible(command.flag);
+        return;
+    }
+    if(command.kind == SimCommand::SetPeriodic)
+    {
+        setPeriodic(command.flag);
+        return;
+    }
+    if(command.kind == SimCommand::SetSleep)
+    {
+        setSleepEnabled(command.flag);
+        return;
+    }
+    if(command.kind == SimCommand::SetThermostat)
+    {
+        setThermostat(command.atom, command.dvx);
+        return;
+    }
+    if(command.kind == SimCommand::Titrate)
+    {
+        if(command.flag)
+            solution.addAcid(command.dvx);
+        else
+            solution.addBase(command.dvx);
+        return;
+    }
+
+    if(command.atom < 0 || command.atom >= (int)atoms.size())
+        return;
+
+    wakeMolecule(atoms[command.atom].molecule);
+    SimMolecule &mol = molecules[atoms[command.atom].molecule];
+    if(!flexible)
+    {
+        mol.vx += command.dvx;
+        mol.vy += command.dvy;
+        mol.angular += command.dAngular;
+        return;
+    }
+
+    double w = command.dAngular * Pi / 180;
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        SimAtom &atom = atoms[mol.members[i]];
+        atom.vx += command.dvx - w * (atom.y - mol.y);
+        atom.vy += command.dvy + w * (atom.x - mol.x);
+    }
+}
+
+void Simulation::step()
+{
+    TRACE_ZONE("step");
+    if(flexible)
+        stepFlexible();
+    else
+        stepRigid();
+    if(thermostat.isEnabled())
+        applyThermostat();
+    // com Langevin ninguem fica parado de verdade: sem sono
+    if(sleepEnabled && thermostat.kind() != Thermostat::Langevin)
+        updateSleep();
+    solution.step(box);
+    stepCount++;
+}
+
+void Simulation::stepRigid()
+{
+    TRACE_ZONE("stepRigid");
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        SimMolecule &mol = molecules[m];
+        if(mol.members.empty() || mol.asleep)
+            continue;
+        mol.x += mol.vx;
+        mol.y += mol.vy;
+        mol.angle += mol.angular;
+        if(box.periodic)
+            wrapMolecule((int)m);
+        updateAtomPositions((int)m);
+    }
+
+    calculateForces();
+}
+
+void Simulation::stepFlexible()
+{
+    TRACE_ZONE("stepFlexible");
+    bool doReaction = computeNonbonded();
+
+    if(!topology.isValid())
+        topology.build(atoms, bonds);
+    topology.addForces(atoms, bonds, bondStiffness, angleStiffness, fx, fy);
+    if(!box.periodic)
+        addWallForces();
+
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        SimAtom &atom = atoms[i];
+        if(molecules[atom.molecule].asleep)
+            continue;
+        double m = massOf(atom);
+        atom.vx += fx[i] / m;
+        atom.vy += fy[i] / m;
+        atom.x += atom.vx;
+        atom.y += atom.vy;
+    }
+    syncMoleculesFromAtoms();
+    if(box.periodic)
+    {
+        for(size_t m = 0; m < molecules.size(); m++)
+        {
+            if(!molecules[m].members.empty())
+                wrapMolecule((int)m);
+        }
+    }
+
+    breakStretchedBonds();
+    if(doReaction)
+        react();
+}
+
+// No modo flexivel a molecula so guarda o centro de massa e a velocidade
+// dele, usados pelo teclado e pela reacao.
+void Simulation::syncMoleculesFromAtoms()
+{
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        SimMolecule &mol = molecules[m];
+        if(mol.members.empty() || mol.mass <= 0 || mol.asleep)
+            continue;
+        mol.x = mol.y = mol.vx = mol.vy = 0;
+        for(size_t i = 0; i < mol.members.size(); i++)
+        {
+            const SimAtom &atom = atoms[mol.members[i]];
+            double m = massOf(atom);
+            mol.x += m * atom.x;
+            mol.y += m * atom.y;
+            mol.vx += m * atom.vx;
+            mol.vy += m * atom.vy;
+        }
+        mol.x /= mol.mass;
+        mol.y /= mol.mass;
+        mol.vx /= mol.mass;
+        mol.vy /= mol.mass;
+    }
+}
+
+// Mola esticada demais arrebenta, e a molecula pode se dividir. O limite
+// e de energia, nao de proporcao do comprimento: uma ligacao formada
+// perto (repouso de 4 ou 5) com limite de 2x arrebentava com qualquer
+// choque. Nas cenas de sempre (T por volta de 25) a mola nao passa de
+// 200, entao so uma cena bem mais quente dissocia.
+void Simulation::breakStretchedBonds()
+{
+    for(size_t k = 0; k < bonds.size(); k++)
+    {
+        const SimBond &bond = bonds[k];
+        if(!bond.visible)
+            continue;
+        // as moleculas ficam inteiras, mas a ligacao nova pode ter vindo
+        // de uma imagem vizinha
+        double dx = atoms[bond.a].x - atoms[bond.b].x;
+        double dy = atoms[bond.a].y - atoms[bond.b].y;
+        box.minimumImage(dx, dy);
+        double stretch = sqrt(dx * dx + dy * dy) - bond.restLength;
+        if(stretch > 0 && 0.5 * bondStiffness * stretch * stretch > breakEnergy)
+            breakBond((int)k);
+    }
+}
+
+void Simulation::writeFrame(SimFrame &frame) const
+{
+    frame.step = stepCount;
+    frame.stats = stats();
+    frame.box = box;
+    frame.x.resize(atoms.size());
+    frame.y.resize(atoms.size());
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        frame.x[i] = atoms[i].x;
+        frame.y[i] = atoms[i].y;
+    }
+    frame.bondA.resize(bonds.size());
+    frame.bondB.resize(bonds.size());
+    frame.bondVisible.resize(bonds.size());
+    for(size_t i = 0; i < bonds.size(); i++)
+    {
+        frame.bondA[i] = bonds[i].a;
+        frame.bondB[i] = bonds[i].b;
+        frame.bondVisible[i] = bonds[i].visible;
+    }
+    frame.element.resize(atoms.size());
+    for(size_t i = 0; i < atoms.size(); i++)
+        frame.element[i] = atoms[i].element;
+    solution.appendTo(frame);
+    frame.solutionAtoms = frame.x.size() - atoms.size();
+    frame.solutionBonds = frame.bondA.size() - bonds.size();
+}
+
+// O estado que decide os proximos passos: atomos, moleculas, ligacoes, a
+// solucao e os contadores. A lista de vizinhos e os contatos sao refeitos
+// a partir disso e ficam de fora.
+uint64_t Simulation::checksum() const
+{
+    StateHash hash;
+    hash.add((long long)stepCount);
+    hash.add(reactionCount);
+    hash.add(flexible ? 1 : 0);
+    hash.add(box.periodic ? 1 : 0);
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        const SimAtom &atom = atoms[i];
+        hash.add(atom.element);
+        hash.add(atom.molecule);
+        hash.add(atom.bodyX);
+        hash.add(atom.bodyY);
+        hash.add(atom.x);
+        hash.add(atom.y);
+        hash.add(atom.vx);
+        hash.add(atom.vy);
+    }
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        const SimMolecule &mol = molecules[m];
+        if(mol.members.empty())
+            continue;
+        hash.add((int)m);
+        hash.add(mol.x);
+        hash.add(mol.y);
+        hash.add(mol.vx);
+        hash.add(mol.vy);
+        hash.add(mol.angle);
+        hash.add(mol.angular);
+        hash.add(mol.restSteps);
+        hash.add(mol.asleep ? 1 : 0);
+    }
+    for(size_t k = 0; k < bonds.size(); k++)
+    {
+        hash.add(bonds[k].a);
+        hash.add(bonds[k].b);
+        hash.add(bonds[k].visible ? 1 : 0);
+        hash.add(bonds[k].restLength);
+    }
+    solution.addToHash(hash);
+    return hash.value();
+}
+
+SimStats Simulation::stats() const
+{
+    SimStats out;
+    out.steps = stepCount;
+    out.neighborRebuilds = neighbors.buildCount();
+    out.neighborPairs = neighbors.pairCount();
+    out.potentialEnergy = potentialEnergy;
+    out.kineticEnergy = kineticEnergy();
+    out.temperature = temperature();
+    out.reactions = reactionCount;
+    out.memoryBytes = memoryUsage();
+    out.pH = solution.isEnabled() ? solution.pH() : 0;
+    out.ionsPerMarker = solution.ionsPerMarker();
+    out.thermostat = thermostat.kind();
+    out.targetTemperature = thermostat.target();
+    out.awakeMolecules = out.sleepingMolecules = 0;
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        if(molecules[m].members.empty())
+            continue;
+        if(molecules[m].asleep)
+            out.sleepingMolecules++;
+        else
+            out.awakeMolecules++;
+    }
+    return out;
+}
+
+// No modo rigido: translacao mais rotacao de cada corpo.
+double Simulation::kineticEnergy() const
+{
+    double energy = 0;
+    if(flexible)
+    {
+        for(size_t i = 0; i < atoms.size(); i++)
+            energy += 0.5 * massOf(atoms[i]) * (atoms[i].vx * atoms[i].vx + atoms[i].vy * atoms[i].vy);
+        return energy;
+    }
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        const SimMolecule &mol = molecules[m];
+        if(mol.members.empty())
+            continue;
+        double w = mol.angular * Pi / 180;
+        energy += 0.5 * mol.mass * (mol.vx * mol.vx + mol.vy * mol.vy);
+        energy += 0.5 * mol.inertia * w * w;
+    }
+    return energy;
+}
+
+// Flexivel: x e y de cada atomo. Rigido: x e y de cada corpo, mais a
+// rotacao quando ele tem mais de um atomo.
+int Simulation::degreesOfFreedom() const
+{
+    return countDegrees(false);
+}
+
+int Simulation::countDegrees(bool awakeOnly) const
+{
+    int count = 0;
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        const SimMolecule &mol = molecules[m];
+        if(mol.members.empty() || (awakeOnly && mol.asleep))
+            continue;
+        if(flexible)
+            count += 2 * (int)mol.members.size();
+        else
+            count += mol.inertia > 1e-9 ? 3 : 2;
+    }
+    return count;
+}
+
+double Simulation::temperature() const
+{
+    int count = degreesOfFreedom();
+    return count > 0 ? 2 * kineticEnergy() / count : 0;
+}
+
+void Simulation::setThermostat(int kind, double target)
+{
+    if(target <= 0)
+    {
+        // quem dorme esta parado: a energia e toda dos acordados
+        int count = countDegrees(true);
+        double energy = kineticEnergy();
+        target = count > 0 && energy > 0 ? 2 * energy / count : thermostat.target();
+    }
+    thermostat.setTarget(target);
+    thermostat.setKind(kind);
+    if(thermostat.kind() == Thermostat::Langevin)
+        wakeAll();
+}
+
+// Uma passada pelas velocidades de quem esta acordado; quem dorme nao
+// entra na temperatura medida nem e mexido. No modo flexivel a
+// velocidade da molecula so e refeita no proximo passo.
+void Simulation::applyThermostat()
+{
+    TRACE_ZONE("applyThermostat");
+    if(thermostat.kind() == Thermostat::Langevin)
+    {
+        double damping = thermostat.damping();
+        if(flexible)
+        {
+            for(size_t i = 0; i < atoms.size(); i++)
+            {
+                SimAtom &atom = atoms[i];
+                if(molecules[atom.molecule].asleep)
+                    continue;
+                double m = massOf(atom);
+                atom.vx = damping * atom.vx + thermostat.kick(m);
+                atom.vy = damping * atom.vy + thermostat.kick(m);
+            }
+            return;
+        }
+        for(size_t m = 0; m < molecules.size(); m++)
+        {
+            SimMolecule &mol = molecules[m];
+            if(mol.members.empty() || mol.asleep)
+                continue;
+            mol.vx = damping * mol.vx + thermostat.kick(mol.mass);
+            mol.vy = damping * mol.vy + thermostat.kick(mol.mass);
+            if(mol.inertia > 1e-9)
+            {
+                // a rotacao e em graus por passo
+                double w = mol.angular * Pi / 180;
+                w = damping * w + thermostat.kick(mol.inertia);
+                mol.angular = w * 180 / Pi;
+            }
+        }
+        return;
+    }
+
+    int count = countDegrees(true);
+    if(count == 0)
+        return;
+    double scale = thermostat.scaleFor(2 * kineticEnergy() / count);
+    if(scale == 1)
+        return;
+    if(flexible)
+    {
+        for(size_t i = 0; i < atoms.size(); i++)
+        {
+            atoms[i].vx *= scale;
+            atoms[i].vy *= scale;
+        }
+        return;
+    }
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        SimMolecule &mol = molecules[m];
+        mol.vx *= scale;
+        mol.vy *= scale;
+        mol.angular *= scale;
+    }
+}
+
+// Conta a capacidade reservada, nao so o tamanho: e o que o processo gasta.
+size_t Simulation::memoryUsage() const
+{
+    size_t bytes = vectorBytes(atoms) + vectorBytes(bonds) + vectorBytes(freeBonds) +
+            vectorBytes(freeMolecules) + vectorBytes(molecules);
+    for(size_t m = 0; m < molecules.size(); m++)
+        bytes += vectorBytes(molecules[m].members);
+    bytes += vectorBytes(atomBonds);
+    for(size_t i = 0; i < atomBonds.size(); i++)
+        bytes += vectorBytes(atomBonds[i]);
+    bytes += components.memoryUsage() + islands.memoryUsage() + vectorBytes(islandReady);
+    bytes += vectorBytes(visitMark) + vectorBytes(fx) + vectorBytes(fy);
+    bytes += neighbors.memoryUsage() + topology.memoryUsage();
+    for(int kind = 0; kind < PairKernelCount; kind++)
+        bytes += vectorBytes(kernelPairs[kind]);
+    bytes += vectorBytes(reactionCandidates) + vectorBytes(touching) + vectorBytes(contacts);
+    bytes += solution.memoryUsage();
+    return bytes;
+}
+
+// Tudo dormindo: o proximo passo nao mudaria nada. A solucao nunca para.
+bool Simulation::isAtRest() const
+{
+    if(solution.isEnabled())
+        return false;
+    for(size_t m = 0; m < molecules.size(); m++)
+    {
+        if(!molecules[m].members.empty() && !molecules[m].asleep)
+            return false;
+    }
+    return true;
+}
+
+void Simulation::updateAtomPositions(int molecule)
+{
+    const SimMolecule &mol = molecules[molecule];
+    double angle = mol.angle * Pi / 180;
+    double c = cos(angle);
+    double s = sin(angle);
+    for(size_t i = 0; i < mol.members.size(); i++)
+    {
+        SimAtom &atom = atoms[mol.members[i]];
+        atom.x = mol.x + atom.bodyX * c - atom.bodyY * s;
+        atom.y = mol.y + atom.bodyX * s + atom.bodyY * c;
+    }
+}
+
+int Simulation::checkBounce(const SimAtom &atom) const
+{
+    int bounce = 0;
+    if(
+            ((box.left + radiusOf(atom) + WallMargin) > atom.x)||
+            ((box.left + box.width - radiusOf(atom) - WallMargin) < atom.x))
+        bounce += 1;
+    if(
+            ((box.top + radiusOf(atom) + WallMargin) > atom.y)||
+            ((box.top + box.height - radiusOf(atom) - WallMargin) < atom.y))
+        bounce += 2;
+
+    return bounce;
+}
+
+void Simulation::addContact(int a, int b, double rax, double ray, double rbx, double rby,
+                            double nx, double ny)
+{
+    const SimMolecule &molA = molecules[a];
+    double invMassA = molA.asleep ? 0 : 1 / molA.mass;
+    double invInertiaA = molA.asleep || molA.inertia < 1e-9 ? 0 : 1 / molA.inertia;
+    double crossA = rax * ny - ray * nx;
+    double inverse = invMassA + crossA * crossA * invInertiaA;
+    if(b >= 0)
+    {
+        const SimMolecule &molB = molecules[b];
+        double invMassB = molB.asleep ? 0 : 1 / molB.mass;
+        double invInertiaB = molB.asleep || molB.inertia < 1e-9 ? 0 : 1 / molB.inertia;
+        double crossB = rbx * ny - rby * nx;
+        inverse += invMassB + crossB * crossB * invInertiaB;
+    }
+    if(inverse <= 0)
+        return;
+
+    Contact c;
+    c.a = a;
+    c.b = b;
+    c.rax = rax;
+    c.ray = ray;
+    c.rbx = rbx;
+    c.rby = rby;
+    c.nx = nx;
+    c.ny = ny;
+    c.normalMass = 1 / inverse;
+    contacts.push_back(c);
+}
+
+// Um contato por atomo que passou da parede ou encosta (soma dos raios)
+// num atomo de outra molecula. O ponto de contato fica na superficie do
+// atomo, entao uma batida fora do centro de massa tambem gira a molecula.
+void Simulation::collectContacts()
+{
+    TRACE_ZONE("collectContacts");
+    contacts.clear();
+
+    if(!box.periodic)
+    {
+        for(size_t i = 0; i < atoms.size(); i++)
+        {
+            const SimAtom &atom = atoms[i];
+            const SimMolecule &mol = molecules[atom.molecule];
+            if(mol.asleep)
+                continue;
+            double r = radiusOf(atom);
+            double ox = atom.x - mol.x;
+            double oy = atom.y - mol.y;
+            if(atom.x - r < box.left + WallMargin)
+                addContact(atom.molecule, -1, ox - r, oy, 0, 0, -1, 0);
+            if(atom.x + r > box.left + box.width - WallMargin)
+                addContact(atom.molecule, -1, ox + r, oy, 0, 0, 1, 0);
+            if(atom.y - r < box.top + WallMargin)
+                addContact(atom.molecule, -1, ox, oy - r, 0, 0, 0, -1);
+            if(atom.y + r > box.top + box.height - WallMargin)
+                addContact(atom.molecule, -1, ox, oy + r, 0, 0, 0, 1);
+        }
+    }
+
+    // os pares encostados ja sairam da soma das forcas
+    for(size_t k = 0; k < touching.size(); k += 2)
+    {
+        const SimAtom &atomI = atoms[touching[k]];
+        const SimAtom &atomJ = atoms[touching[k + 1]];
+        const SimMolecule &molA = molecules[atomI.molecule];
+        const SimMolecule &molB = molecules[atomJ.molecule];
+        double dx = atomJ.x - atomI.x;
+        double dy = atomJ.y - atomI.y;
+        box.minimumImage(dx, dy);
+        double d = sqrt(dx * dx + dy * dy);
+        if(d < 1e-6)
+            continue;
+        double ri = radiusOf(atomI);
+        double rj = radiusOf(atomJ);
+        double nx = dx / d;
+        double ny = dy / d;
+        addContact(atomI.molecule, atomJ.molecule,
+                   atomI.x - molA.x + nx * ri, atomI.y - molA.y + ny * ri,
+                   atomJ.x - molB.x - nx * rj, atomJ.y - molB.y - ny * rj,
+                   nx, ny);
+    }
+}
+
+// velocidade do ponto de contato de b menos a de a, ao longo da normal;
+// negativa quando eles se aproximam
+double Simulation::normalVelocity(const Contact &c) const
+{
+    const double toRadians = Pi / 180;
+    const SimMolecule &molA = molecules[c.a];
+    double wa = molA.angular * toRadians;
+    double vn = -((molA.vx - wa * c.ray) * c.nx + (molA.vy + wa * c.rax) * c.ny);
+    if(c.b >= 0)
+    {
+        const SimMolecule &molB = molecules[c.b];
+        double wb = molB.angular * toRadians;
+        vn += (molB.vx - wb * c.rby) * c.nx + (molB.vy + wb * c.rbx) * c.ny;
+    }
+    return vn;
+}
+
+// Impulsos sequenciais: a cada passada, cada contato que ainda se
+// aproxima leva o impulso de um choque de dois corpos com as velocidades
+// de agora. Com restitution = 1 cada choque guarda a energia cinetica,
+// entao a passada inteira tambem guarda, qualquer que seja a ordem.
+// Moleculas dormindo entram com massa infinita. Velocidade angular em
+// graus por passo, como no resto.
+void Simulation::solveContacts()
+{
+    TRACE_ZONE("solveContacts");
+    collectContacts();
+
+    const double toRadians = Pi / 180;
+    for(int pass = 0; pass < contactIterations; pass++)
+    {
+        bool changed = false;
+        for(size_t k = 0; k < contacts.size(); k++)
+        {
+            const Contact &c = contacts[k];
+            double vn = normalVelocity(c);
+            if(vn >= 0)
+                continue;
+            changed = true;
+
+            double impulse = -(1 + restitution) * vn * c.normalMass;
+            double px = impulse * c.nx;
+            double py = impulse * c.ny;
+            SimMolecule &molA = molecules[c.a];
+            if(!molA.asleep)
+            {
+                molA.vx -= px / molA.mass;
+                molA.vy -= py / molA.mass;
+                if(molA.inertia > 1e-9)
+                    molA.angular -= (c.rax * py - c.ray * px) / molA.inertia / toRadians;
+            }
+            if(c.b < 0)
+                continue;
+            SimMolecule &molB = molecules[c.b];
+            if(!molB.asleep)
+            {
+                molB.vx += px / molB.mass;
+                molB.vy += py / molB.mass;
+                if(molB.inertia > 1e-9)
+                    molB.angular += (c.rbx * py - c.rby * px) / molB.inertia / toRadians;
+            }
+        }
+        if(!changed)
+            break;
+    }
+}
+
+// As paredes do modo flexivel: uma mola que so empurra, no atomo que
+// passou do limite do checkBounce. Inverter a velocidade (como no modo
+// rigido) nao serve aqui: com a ligacao puxando o atomo de volta, cada
+// inversao fora de hora poe energia na mola, e a molecula acaba
+// arrebentando. A mola entra na energia e conserva como as outras.
+void Simulation::addWallForces()
+{
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        const SimAtom &atom = atoms[i];
+        if(molecules[atom.molecule].asleep)
+            continue;
+        double inset = radiusOf(atom) + WallMargin;
+        double left = box.left + inset - atom.x;
+        double right = atom.x - (box.left + box.width - inset);
+        double top = box.top + inset - atom.y;
+        double bottom = atom.y - (box.top + box.height - inset);
+        double depth;
+        if((depth = std::max(left, right)) > 0)
+        {
+            fx[i] += (left > 0 ? WallStiffness : -WallStiffness) * depth;
+            potentialEnergy += 0.5 * WallStiffness * depth * depth;
+        }
+        if((depth = std::max(top, bottom)) > 0)
+        {
+            fy[i] += (top > 0 ? WallStiffness : -WallStiffness) * depth;
+            potentialEnergy += 0.5 * WallStiffness * depth * depth;
+        }
+    }
+}
+
+// Forca entre atomos de moleculas diferentes, por atomo, em fx/fy.
+// Retorna true se alguma reacao deve acontecer neste passo.
+bool Simulation::computeNonbonded()
+{
+    TRACE_ZONE("computeNonbonded");
+    if(neighbors.update(atoms, box))
+        sortPairsByKernel();
+    resetIslands();
+
+    fx.assign(atoms.size(), 0);
+    fy.assign(atoms.size(), 0);
+    potentialEnergy = 0;
+    reactionCandidates.clear();
+    touching.clear();
+
+    accumulatePairs<TabulatedKernel>();
+    accumulatePairs<LennardJonesKernel>();
+    accumulatePairs<SoftCoreKernel>();
+
+    return reaction && !reactionCandidates.empty();
+}
+
+// Os pares (i, j) da lista de vizinhos, um vetor por kernel.
+void Simulation::sortPairsByKernel()
+{
+    for(int kind = 0; kind < PairKernelCount; kind++)
+        kernelPairs[kind].clear();
+    for(int i = 0; i < (int)atoms.size(); i++)
+    {
+        for(int k = neighbors.begin(i); k < neighbors.end(i); k++)
+        {
+            int j = neighbors.neighbor(k);
+            std::vector<int> &list = kernelPairs[pairs.params(atoms[i].type, atoms[j].type).kernel];
+            list.push_back(i);
+            list.push_back(j);
+        }
+    }
+}
+
+template <int Kind>
+void Simulation::accumulatePairs()
+{
+    const std::vector<int> &list = kernelPairs[Kind];
+    for(size_t k = 0; k < list.size(); k += 2)
+    {
+        int i = list[k];
+        int j = list[k + 1];
+        const SimAtom &atomI = atoms[i];
+        const SimAtom &atomJ = atoms[j];
+        // duas moleculas dormindo nao se mexem nem se acordam
+        if(molecules[atomI.molecule].asleep && molecules[atomJ.molecule].asleep)
+            continue;
+
+        double dx = atomI.x - atomJ.x;
+        double dy = atomI.y - atomJ.y;
+        box.minimumImage(dx, dy);
+        double r2 = dx * dx + dy * dy;
+
+        const PairParams &p = pairs.params(atomI.type, atomJ.type);
+        if(r2 < p.contact2)
+            contact(i, j);
+        if(r2 < p.reaction2)
+        {
+            reactionCandidates.push_back(i);
+            reactionCandidates.push_back(j);
+        }
+
+        // no modo rigido dois atomos encostados ja sao separados pelo choque
+        // (solveContacts); o potencial fica plano ali dentro, senao a forca
+        // e o impulso brigam e a energia escorre
+        if(!flexible && r2 < p.touch2 && atomI.molecule != atomJ.molecule)
+        {
+            touching.push_back(i);
+            touching.push_back(j);
+            double forceOverR, energy;
+            if(PairKernel<Kind>::evaluate(p, p.touch2, forceOverR, energy))
+                potentialEnergy += energy;
+            continue;
+        }
+
+        double forceOverR, energy;
+        if(!PairKernel<Kind>::evaluate(p, r2, forceOverR, energy))
+            continue;
+        potentialEnergy += energy;
+        fx[i] += forceOverR * dx;
+        fy[i] += forceOverR * dy;
+        fx[j] -= forceOverR * dx;
+        fy[j] -= forceOverR * dy;
+    }
+}
+
+// No modo rigido a forca em cada atomo vira forca e torque no corpo. Os
+// choques ficam entre duas metades do chute: com o chute inteiro de um
+// lado so, o erro de cada choque tem sempre o mesmo sinal e uma cena
+// cheia esfria (ou esquenta) sozinha.
+void Simulation::calculateForces()
+{
+    TRACE_ZONE("calculateForces");
+    bool doReaction = computeNonbonded();
+
+    kickMolecules(0.5);
+    solveContacts();
+    kickMolecules(0.5);
+
+    if(doReaction)
+        react();
+}
+
+void Simulation::kickMolecules(double fraction)
+{
+    for(size_t i = 0; i < atoms.size(); i++)
+    {
+        const SimAtom &atom = atoms[i];
+        SimMolecule &mol = molecules[atom.molecule];
+        if(mol.asleep)
+            continue;
+        mol.vx += fraction * fx[i] / mol.mass;
+        mol.vy += fraction * fy[i] / mol.mass;
+        if(mol.inertia > 1e-9)
+        {
+            double torque = (atom.x - mol.x) * fy[i] - (atom.y - mol.y) * fx[i];
+            mol.angular += fraction * torque / mol.inertia * 180 / Pi;
+        }
+    }
+}
+
+// O atomo ligado do par troca de parceiro: H-Cl + F -> H-F + Cl. O outro
+// atomo tem que estar sozinho, e a troca por um igual (H-F + F) nao conta.
+void Simulation::react()
+{
+    TRACE_ZONE("react");
+    for(size_t k = 0; k < reactionCandidates.size(); k += 2)
+    {
+        int a = reactionCandidates[k];
+        int b = reactionCandidates[k + 1];
+        if(atomBonds[a].empty() == atomBonds[b].empty())
+            continue;
+
+        int bound = atomBonds[a].empty() ? b : a;
+        int single = bound == a ? b : a;
+        int bond = atomBonds[bound][0];
+        int partner = bonds[bond].a == bound ? bonds[bond].b : bonds[bond].a;
+        if(atoms[partner].element == atoms[single].element)
+            continue;
+
+        wakeNear(atoms[bound].x, atoms[bound].y);
+        breakBond(bond);
+        formBond(bound, single);
+        reactionCount++;
+    }
+}
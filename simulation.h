@@ -0,0 +1,184 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "simtypes.h"
+#include "neighborlist.h"
+#include "bondtopology.h"
+#include "unionfind.h"
+#include "pairpotential.h"
+#include "bulksolution.h"
+#include "thermostat.h"
+
+class Simulation
+{
+public:
+    Simulation();
+
+    void setBox(double left, double top, double width, double height);
+    double boxLeft() const { return box.left; }
+    double boxTop() const { return box.top; }
+    double boxWidth() const { return box.width; }
+    double boxHeight() const { return box.height; }
+    void setPeriodic(bool on);
+    bool isPeriodic() const { return box.periodic; }
+
+    // cada atomo novo e uma molecula; formBond/breakBond juntam e separam
+    int addAtom(int element, double x, double y);
+    int formBond(int a, int b);
+    void breakBond(int bond);
+    int moleculeOf(int atom) const { return atoms[atom].molecule; }
+    void setMoleculeVelocity(int molecule, double vx, double vy, double angular);
+    void loadDefaultScene();
+    void loadEncounter(double speed, double angle, double spin);
+    void loadScenario(const Scenario &scenario);
+
+    int atomCount() const { return (int)atoms.size(); }
+    int bondCount() const { return (int)bonds.size(); }
+    const SimAtom &atom(int i) const { return atoms[i]; }
+    const SimBond &bond(int i) const { return bonds[i]; }
+    int moleculeCount() const { return (int)molecules.size(); } // inclui vagas livres
+    const SimMolecule &molecule(int i) const { return molecules[i]; }
+
+    void setNeighborSkin(double skin) { neighbors.setSkin(skin); }
+    void setPairPotential(int elementA, int elementB, const PairPotential &term);
+    void addPairPotential(int elementA, int elementB, const PairPotential &term);
+    void setReaction(int elementA, int elementB, double distance);
+    void setFlexible(bool on);
+    bool isFlexible() const { return flexible; }
+    void setSleepEnabled(bool on);
+    bool isSleepEnabled() const { return sleepEnabled; }
+    // target <= 0: a temperatura de quem esta acordado agora
+    void setThermostat(int kind, double target);
+    int thermostatKind() const { return thermostat.kind(); }
+    double targetTemperature() const { return thermostat.target(); }
+    SimStats stats() const;
+    double kineticEnergy() const;
+    int degreesOfFreedom() const;
+    double temperature() const; // 2 KE / graus de liberdade, com k = 1
+    size_t memoryUsage() const; // bytes de tudo que cresce com a cena
+    double massOf(const SimAtom &atom) const { return typeMass[atom.type]; }
+    double radiusOf(const SimAtom &atom) const { return typeRadius[atom.type]; }
+    int reactions() const { return reactionCount; }
+    bool isAtRest() const;
+
+    void apply(const SimCommand &command);
+    void step();
+    void writeFrame(SimFrame &frame) const;
+    // muda se qualquer bit do estado mudar (StateHash); para o GoldenRun
+    uint64_t checksum() const;
+
+private:
+    SimBox box;
+    unsigned long long stepCount;
+
+    std::vector<SimAtom> atoms;
+    std::vector<double> typeMass, typeRadius;
+    std::vector<SimMolecule> molecules;
+    std::vector<SimBond> bonds;
+    std::vector<int> freeBonds;
+    std::vector<int> freeMolecules;
+
+    // grafo das ligacoes: uniao para formar, busca local para quebrar
+    std::vector<std::vector<int> > atomBonds;
+    UnionFind components;
+    std::vector<unsigned> visitMark;
+    unsigned visitEpoch;
+
+    // usada pela forca, pelo contato e pela distancia de reacao
+    NeighborList neighbors;
+    std::vector<double> fx, fy;
+
+    // potencial entre moleculas diferentes: matriz por par de elementos e
+    // os pares da lista de vizinhos separados pelo kernel de cada um
+    PairPotentials pairs;
+    std::vector<int> kernelPairs[PairKernelCount];
+    double potentialEnergy;
+    void updateCutoff();
+    void sortPairsByKernel();
+    template <int Kind> void accumulatePairs();
+
+    // moleculas paradas dormem em ilhas: um grupo em contato so dorme
+    // quando todos estao parados, e acorda com contato, reacao ou teclado
+    bool sleepEnabled;
+    double sleepSpeed;
+    double sleepSpin;
+    int sleepDelay;
+    double contactMargin;
+    double wakeRadius;
+    UnionFind islands;
+    std::vector<char> islandReady;
+
+    // modo flexivel: molas harmonicas sobre as ligacoes em CSR
+    bool flexible;
+    double bondStiffness;
+    double angleStiffness;
+    double breakEnergy;     // energia da mola que arrebenta a ligacao
+    BondTopology topology;
+
+    // H+ e OH- da agua em volta: contados, nao simulados
+    BulkSolution solution;
+
+    // depois de cada passo, so nas moleculas acordadas
+    Thermostat thermostat;
+    int countDegrees(bool awakeOnly) const;
+    void applyThermostat();
+
+    // H-Cl + F -> H-F + Cl: os pares que reagem vem da matriz
+    bool reaction;
+    int reactionCount;
+    std::vector<int> reactionCandidates;
+    std::vector<int> touching; // pares (i, j) mais perto que rA + rB, modo rigido
+
+    int newMolecule();
+    void mergeMolecules(int atomA, int atomB);
+    void shiftMolecule(int molecule, double dx, double dy);
+    void wrapMolecule(int molecule);
+    void splitIfDisconnected(int a, int b);
+    void collectComponent(int start, std::vector<int> &out);
+    void materializeVelocities(int molecule);
+    void rebuildBody(int molecule);
+    void wakeMolecule(int molecule);
+    void wakeAll();
+    void wakeNear(double x, double y);
+    bool isResting(int molecule) const;
+    void resetIslands();
+    void contact(int atomA, int atomB);
+    void updateSleep();
+
+    // choques do modo rigido: um contato por atomo encostado, na parede ou
+    // num atomo de outra molecula, e todos resolvidos juntos por impulsos
+    // (linear e angular) em algumas passadas sobre o vetor de contatos
+    struct Contact
+    {
+        int a, b;           // moleculas; b = -1 e a parede
+        double rax, ray;    // ponto de contato a partir de cada centro de massa
+        double rbx, rby;
+        double nx, ny;      // normal de a para b
+        double normalMass;  // massa efetiva ao longo da normal
+    };
+    std::vector<Contact> contacts;
+    double restitution;
+    int contactIterations;
+    void addContact(int a, int b, double rax, double ray, double rbx, double rby,
+                    double nx, double ny);
+    void collectContacts();
+    double normalVelocity(const Contact &c) const;
+    void solveContacts();
+
+    void updateAtomPositions(int molecule);
+    int checkBounce(const SimAtom &atom) const;//0-no | 1-x | 2-y | 3-xy
+    void addWallForces();
+    void stepRigid();
+    void stepFlexible();
+    void syncMoleculesFromAtoms();
+    bool computeNonbonded();
+    void calculateForces();
+    void kickMolecules(double fraction);
+    void breakStretchedBonds();
+    void react();
+};
+
+#endif // SIMULATION_H
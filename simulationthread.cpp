@@ -0,0 +1,175 @@
+#include "simulationthread.h"
+#include "analysisthread.h"
+#include "trace.h"
+#include "startupclock.h"
+
+#include <QElapsedTimer>
+
+SimulationThread::SimulationThread(Simulation *sim, const Scenario &toLoad, QObject *parent)
+    : QThread(parent), simulation(sim), scenario(toLoad), stepInterval(1000 / 25), stepCost(0),
+      analysis(0), paused(false), idle(false)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+    delete simulation;
+}
+
+void SimulationThread::stop()
+{
+    requestInterruption();
+    {
+        QMutexLocker locker(&idleLock);
+        wakeUp.wakeAll();
+    }
+    wait();
+}
+
+bool SimulationThread::postCommand(const SimCommand &command)
+{
+    if(!commands.push(command))
+        return false;
+
+    // quem chamou ja ve a thread acordada, antes dela sair da espera
+    QMutexLocker locker(&idleLock);
+    idle = false;
+    wakeUp.wakeAll();
+    return true;
+}
+
+void SimulationThread::setPaused(bool on)
+{
+    QMutexLocker locker(&idleLock);
+    paused = on;
+    if(!on)
+    {
+        idle = false;
+        wakeUp.wakeAll();
+    }
+}
+
+int SimulationThread::framePeriod() const
+{
+    int cost = (stepCost.load() + 999) / 1000;
+    return qMax(stepInterval, cost);
+}
+
+// Bloqueia enquanto nao ha nada a fazer. O teste e feito com o lock,
+// o mesmo que postCommand() e setPaused() pegam para acordar, entao
+// nenhum aviso se perde.
+void SimulationThread::waitForWork()
+{
+    QMutexLocker locker(&idleLock);
+    while(!isInterruptionRequested() &&
+          (paused.load() || (commands.empty() && simulation->isAtRest())))
+    {
+        idle = true;
+        wakeUp.wait(&idleLock);
+    }
+    idle = false;
+}
+
+const SimFrame *SimulationThread::takeFrame()
+{
+    if(!frames.update())
+        return 0;
+    return &frames.readBuffer();
+}
+
+const SimFrame &SimulationThread::latestFrame()
+{
+    frames.update();
+    return frames.readBuffer();
+}
+
+void SimulationThread::publishFrame()
+{
+    SimFrame &frame = frames.writeBuffer();
+    simulation->writeFrame(frame);
+    {
+        QMutexLocker locker(&historyLock);
+        history.record(frame);
+    }
+    if(AnalysisThread *observer = analysis.load())
+        observer->offer(frame);
+    frames.publish();
+}
+
+bool SimulationThread::seekHistory(unsigned long long step, SimFrame &frame)
+{
+    QMutexLocker locker(&historyLock);
+    return history.seek(step, frame);
+}
+
+bool SimulationThread::lastReactionStep(unsigned long long &step)
+{
+    QMutexLocker locker(&historyLock);
+    return history.lastReactionStep(step);
+}
+
+void SimulationThread::historyRange(unsigned long long &first, unsigned long long &last)
+{
+    QMutexLocker locker(&historyLock);
+    first = history.firstStep();
+    last = history.lastStep();
+}
+
+size_t SimulationThread::historyBytes()
+{
+    QMutexLocker locker(&historyLock);
+    return history.memoryUsage();
+}
+
+void SimulationThread::run()
+{
+    TRACE_THREAD("simulation");
+    QElapsedTimer clock;
+    clock.start();
+    qint64 nextStep = 0;
+
+    QElapsedTimer cost;
+
+    // a cena montada vira o primeiro quadro, antes do primeiro passo
+    {
+        TRACE_ZONE("loadScenario");
+        qint64 since = StartupClock::elapsed();
+        simulation->loadScenario(scenario);
+        publishFrame();
+        StartupClock::mark("carregar cenario", since);
+    }
+    nextStep = clock.elapsed();
+
+    while(!isInterruptionRequested())
+    {
+        // so pega o lock quando nao ha o que fazer
+        if(paused.load() || (commands.empty() && simulation->isAtRest()))
+        {
+            waitForWork();
+            nextStep = clock.elapsed();
+            if(isInterruptionRequested())
+                break;
+        }
+
+        SimCommand command;
+        while(commands.pop(command))
+            simulation->apply(command);
+
+        cost.start();
+        simulation->step();
+        {
+            TRACE_ZONE("writeFrame");
+            publishFrame();
+        }
+        int us = (int)(cost.nsecsElapsed() / 1000);
+        stepCost = (stepCost.load() * 7 + us) / 8;
+
+        nextStep += stepInterval;
+        qint64 sleepTime = nextStep - clock.elapsed();
+        if(sleepTime > 0)
+            msleep(sleepTime);
+        else
+            nextStep = clock.elapsed();
+    }
+}
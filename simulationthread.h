@@ -0,0 +1,80 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+#include "simulation.h"
+#include "framehistory.h"
+#include "triplebuffer.h"
+#include "spscqueue.h"
+
+class AnalysisThread;
+
+// Roda a Simulation fora da thread da interface. Cada passo completo e
+// publicado num TripleBuffer e os comandos do teclado chegam por uma fila
+// sem lock, aplicados entre um passo e outro. Nenhum lado espera o outro.
+//
+// Com tudo dormindo, ou com a janela escondida, a thread para de dar
+// passos e fica bloqueada ate chegar um comando ou a janela voltar.
+//
+// O cenario e montado ja dentro da thread, no inicio de run(): a janela
+// abre vazia e o primeiro quadro chega quando a cena fica pronta.
+//
+// Cada passo tambem vai para um FrameHistory, para a janela poder voltar
+// no tempo. So esse historico usa lock, e a janela so o le com a
+// simulacao pausada. Com setAnalysis() o passo tambem e oferecido a uma
+// AnalysisThread, que o pega quando pode.
+class SimulationThread : public QThread
+{
+public:
+    SimulationThread(Simulation *sim, const Scenario &toLoad, QObject *parent = 0);
+    ~SimulationThread();
+
+    void stop();
+
+    // chamados pela thread da interface
+    bool postCommand(const SimCommand &command);
+    const SimFrame *takeFrame();
+    const SimFrame &latestFrame(); // o ultimo publicado, novo ou nao
+    void setPaused(bool on);
+    void setAnalysis(AnalysisThread *observer) { analysis = observer; }
+    bool isIdle() const { return idle.load(); }
+    int framePeriod() const; // ms entre quadros, com o custo medido do passo
+
+    bool seekHistory(unsigned long long step, SimFrame &frame);
+    template<class Visitor>
+    bool replayHistory(Visitor visit)
+    {
+        QMutexLocker locker(&historyLock);
+        return history.replay(visit);
+    }
+    bool lastReactionStep(unsigned long long &step);
+    void historyRange(unsigned long long &first, unsigned long long &last);
+    size_t historyBytes();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    Simulation *simulation;
+    Scenario scenario;
+    TripleBuffer<SimFrame> frames;
+    SpscQueue<SimCommand, 256> commands;
+    FrameHistory history;
+    QMutex historyLock;
+    void publishFrame();
+    int stepInterval; // ms
+    std::atomic<int> stepCost; // us, media movel do passo + escrita do quadro
+    std::atomic<AnalysisThread *> analysis;
+
+    QMutex idleLock;
+    QWaitCondition wakeUp;
+    std::atomic<bool> paused;
+    std::atomic<bool> idle;
+    void waitForWork();
+};
+
+#endif // SIMULATIONTHREAD_H
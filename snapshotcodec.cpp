@@ -0,0 +1,420 @@
+#include "snapshotcodec.h"
+
+#include <string.h>
+
+namespace {
+
+enum { KeyFrame = 'K', DeltaFrame = 'D' };
+
+void putByte(std::vector<uint8_t> &out, uint8_t value)
+{
+    out.push_back(value);
+}
+
+void putVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+void putSigned(std::vector<uint8_t> &out, int64_t value)
+{
+    putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void putDouble(std::vector<uint8_t> &out, double value)
+{
+    uint8_t bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(double));
+    out.insert(out.end(), bytes, bytes + sizeof(double));
+}
+
+// Leitura com limite: qualquer leitura alem do fim marca a mensagem
+// como ruim e devolve zero, entao quem le so confere ok no final.
+struct Reader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool ok;
+
+    Reader(const uint8_t *d, size_t s) : data(d), size(s), pos(0), ok(true) {}
+
+    uint8_t byte()
+    {
+        if(pos >= size)
+        {
+            ok = false;
+            return 0;
+        }
+        return data[pos++];
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t b = byte();
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if(!(b & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t signedVarint()
+    {
+        uint64_t value = varint();
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    double real()
+    {
+        if(pos > size || size - pos < sizeof(double))
+        {
+            ok = false;
+            pos = size;
+            return 0;
+        }
+        double value;
+        memcpy(&value, data + pos, sizeof(double));
+        pos += sizeof(double);
+        return value;
+    }
+
+    // um contador que pede mais itens do que cabem no resto da mensagem
+    // (cada item tem pelo menos um byte) e lixo
+    size_t count(size_t limit)
+    {
+        uint64_t value = varint();
+        if(value > size - pos || value > limit)
+        {
+            ok = false;
+            return 0;
+        }
+        return (size_t)value;
+    }
+};
+
+struct Header
+{
+    uint8_t kind;
+    unsigned long long step;
+    SimStats stats;
+    SimBox box;
+    size_t atoms;
+    size_t bonds;
+    size_t solutionAtoms;
+    size_t solutionBonds;
+};
+
+bool readHeader(Reader &in, Header &header)
+{
+    header.kind = in.byte();
+    header.step = in.varint();
+    SimStats &stats = header.stats;
+    stats.steps = in.varint();
+    stats.neighborRebuilds = in.varint();
+    stats.neighborPairs = (int)in.varint();
+    stats.awakeMolecules = (int)in.varint();
+    stats.sleepingMolecules = (int)in.varint();
+    stats.reactions = (int)in.varint();
+    stats.memoryBytes = in.varint();
+    stats.potentialEnergy = in.real();
+    stats.kineticEnergy = in.real();
+    stats.temperature = in.real();
+    stats.pH = in.real();
+    stats.ionsPerMarker = in.real();
+    stats.thermostat = (int)in.varint();
+    stats.targetTemperature = in.real();
+    header.box.left = in.real();
+    header.box.top = in.real();
+    header.box.width = in.real();
+    header.box.height = in.real();
+    header.box.periodic = in.byte() != 0;
+    header.atoms = (size_t)in.varint();
+    header.bonds = (size_t)in.varint();
+    header.solutionAtoms = (size_t)in.varint();
+    header.solutionBonds = (size_t)in.varint();
+    if(header.solutionAtoms > header.atoms || header.solutionBonds > header.bonds)
+        in.ok = false;
+    return in.ok;
+}
+
+void applyHeader(const Header &header, SimFrame &frame)
+{
+    frame.step = header.step;
+    frame.stats = header.stats;
+    frame.box = header.box;
+    frame.solutionAtoms = header.solutionAtoms;
+    frame.solutionBonds = header.solutionBonds;
+}
+
+}
+
+SnapshotEncoder::SnapshotEncoder(double quantum)
+    : quantum(quantum), haveState(false), step(0), solutionAtoms(0), solutionBonds(0)
+{
+    stats = SimStats();
+    box = SimBox();
+}
+
+void SnapshotEncoder::writeHeader(uint8_t kind, std::vector<uint8_t> &out) const
+{
+    putByte(out, kind);
+    putVarint(out, step);
+    putVarint(out, stats.steps);
+    putVarint(out, stats.neighborRebuilds);
+    putVarint(out, (uint64_t)stats.neighborPairs);
+    putVarint(out, (uint64_t)stats.awakeMolecules);
+    putVarint(out, (uint64_t)stats.sleepingMolecules);
+    putVarint(out, (uint64_t)stats.reactions);
+    putVarint(out, stats.memoryBytes);
+    putDouble(out, stats.potentialEnergy);
+    putDouble(out, stats.kineticEnergy);
+    putDouble(out, stats.temperature);
+    putDouble(out, stats.pH);
+    putDouble(out, stats.ionsPerMarker);
+    putVarint(out, (uint64_t)stats.thermostat);
+    putDouble(out, stats.targetTemperature);
+    putDouble(out, box.left);
+    putDouble(out, box.top);
+    putDouble(out, box.width);
+    putDouble(out, box.height);
+    putByte(out, box.periodic ? 1 : 0);
+    putVarint(out, element.size());
+    putVarint(out, bondA.size());
+    putVarint(out, solutionAtoms);
+    putVarint(out, solutionBonds);
+}
+
+void SnapshotEncoder::encodeKey(std::vector<uint8_t> &out) const
+{
+    out.clear();
+    writeHeader(KeyFrame, out);
+    putDouble(out, quantum);
+    for(size_t i = 0; i < element.size(); i++)
+    {
+        putVarint(out, (uint64_t)element[i]);
+        putSigned(out, qx[i]);
+        putSigned(out, qy[i]);
+    }
+    for(size_t i = 0; i < bondA.size(); i++)
+    {
+        putVarint(out, (uint64_t)bondA[i]);
+        putVarint(out, (uint64_t)bondB[i]);
+        putByte(out, bondVisible[i] ? 1 : 0);
+    }
+}
+
+bool SnapshotEncoder::encode(const SimFrame &frame, std::vector<uint8_t> &out)
+{
+    size_t atoms = frame.x.size();
+    size_t bonds = frame.bondA.size();
+    bool key = !haveState || atoms != element.size() || bonds < bondA.size() ||
+            frame.element != element;
+
+    step = frame.step;
+    stats = frame.stats;
+    box = frame.box;
+    solutionAtoms = frame.solutionAtoms;
+    solutionBonds = frame.solutionBonds;
+
+    if(key)
+    {
+        element = frame.element;
+        qx.resize(atoms);
+        qy.resize(atoms);
+        for(size_t i = 0; i < atoms; i++)
+        {
+            qx[i] = (int32_t)lround(frame.x[i] / quantum);
+            qy[i] = (int32_t)lround(frame.y[i] / quantum);
+        }
+        bondA = frame.bondA;
+        bondB = frame.bondB;
+        bondVisible = frame.bondVisible;
+        haveState = true;
+        encodeKey(out);
+        return true;
+    }
+
+    // ligacoes novas entram no fim; o cabecalho ja leva o numero novo
+    size_t known = bondA.size();
+    bondA.resize(bonds);
+    bondB.resize(bonds);
+    bondVisible.resize(bonds);
+
+    out.clear();
+    writeHeader(DeltaFrame, out);
+
+    // o numero de atomos mudados so e conhecido no fim: os atomos vao
+    // para um buffer a parte e a contagem entra antes dele
+    std::vector<uint8_t> &changes = scratch;
+    changes.clear();
+    size_t changed = 0;
+    size_t previous = 0;
+    for(size_t i = 0; i < atoms; i++)
+    {
+        int32_t x = (int32_t)lround(frame.x[i] / quantum);
+        int32_t y = (int32_t)lround(frame.y[i] / quantum);
+        if(x == qx[i] && y == qy[i])
+            continue;
+        putVarint(changes, i - previous);
+        putSigned(changes, (int64_t)x - qx[i]);
+        putSigned(changes, (int64_t)y - qy[i]);
+        qx[i] = x;
+        qy[i] = y;
+        previous = i;
+        changed++;
+    }
+    putVarint(out, changed);
+    out.insert(out.end(), changes.begin(), changes.end());
+
+    // ligacoes: as que mudaram e as novas
+    changes.clear();
+    changed = 0;
+    previous = 0;
+    for(size_t i = 0; i < bonds; i++)
+    {
+        if(i < known && frame.bondA[i] == bondA[i] && frame.bondB[i] == bondB[i] &&
+                frame.bondVisible[i] == bondVisible[i])
+            continue;
+        putVarint(changes, i - previous);
+        putVarint(changes, (uint64_t)frame.bondA[i]);
+        putVarint(changes, (uint64_t)frame.bondB[i]);
+        putByte(changes, frame.bondVisible[i] ? 1 : 0);
+        bondA[i] = frame.bondA[i];
+        bondB[i] = frame.bondB[i];
+        bondVisible[i] = frame.bondVisible[i];
+        previous = i;
+        changed++;
+    }
+    putVarint(out, changed);
+    out.insert(out.end(), changes.begin(), changes.end());
+    return false;
+}
+
+SnapshotDecoder::SnapshotDecoder()
+    : haveKey(false), quantum(1)
+{
+}
+
+bool SnapshotDecoder::decode(const uint8_t *data, size_t size, SimFrame &frame)
+{
+    Reader in(data, size);
+    Header header;
+    if(!readHeader(in, header))
+        return false;
+
+    if(header.kind == KeyFrame)
+    {
+        double q = in.real();
+        if(!in.ok || !(q > 0) || header.atoms > size || header.bonds > size)
+            return false;
+
+        SimFrame key;
+        std::vector<int32_t> keyX(header.atoms), keyY(header.atoms);
+        key.element.resize(header.atoms);
+        for(size_t i = 0; i < header.atoms; i++)
+        {
+            key.element[i] = (int)in.varint();
+            keyX[i] = (int32_t)in.signedVarint();
+            keyY[i] = (int32_t)in.signedVarint();
+        }
+        key.bondA.resize(header.bonds);
+        key.bondB.resize(header.bonds);
+        key.bondVisible.resize(header.bonds);
+        for(size_t i = 0; i < header.bonds; i++)
+        {
+            key.bondA[i] = (int)in.varint();
+            key.bondB[i] = (int)in.varint();
+            key.bondVisible[i] = in.byte() != 0;
+            if(key.bondA[i] < 0 || key.bondA[i] >= (int)header.atoms ||
+                    key.bondB[i] < 0 || key.bondB[i] >= (int)header.atoms)
+                in.ok = false;
+        }
+        if(!in.ok)
+            return false;
+
+        quantum = q;
+        qx.swap(keyX);
+        qy.swap(keyY);
+        frame.element.swap(key.element);
+        frame.bondA.swap(key.bondA);
+        frame.bondB.swap(key.bondB);
+        frame.bondVisible.swap(key.bondVisible);
+        frame.x.resize(header.atoms);
+        frame.y.resize(header.atoms);
+        for(size_t i = 0; i < header.atoms; i++)
+        {
+            frame.x[i] = qx[i] * quantum;
+            frame.y[i] = qy[i] * quantum;
+        }
+        applyHeader(header, frame);
+        haveKey = true;
+        return true;
+    }
+
+    if(header.kind != DeltaFrame || !haveKey || header.atoms != qx.size() ||
+            header.bonds < frame.bondA.size())
+        return false;
+
+    // le tudo antes de aplicar, para uma mensagem ruim nao deixar o
+    // estado pela metade
+    struct AtomChange { size_t index; int64_t dx, dy; };
+    struct BondChange { size_t index; int a, b; bool visible; };
+    std::vector<AtomChange> atomChanges(in.count(header.atoms));
+    size_t index = 0;
+    for(size_t k = 0; k < atomChanges.size(); k++)
+    {
+        index += in.varint();
+        atomChanges[k].index = index;
+        atomChanges[k].dx = in.signedVarint();
+        atomChanges[k].dy = in.signedVarint();
+        if(index >= header.atoms)
+            in.ok = false;
+    }
+    std::vector<BondChange> bondChanges(in.count(header.bonds));
+    index = 0;
+    for(size_t k = 0; k < bondChanges.size(); k++)
+    {
+        index += in.varint();
+        bondChanges[k].index = index;
+        bondChanges[k].a = (int)in.varint();
+        bondChanges[k].b = (int)in.varint();
+        bondChanges[k].visible = in.byte() != 0;
+        if(index >= header.bonds ||
+                bondChanges[k].a < 0 || bondChanges[k].a >= (int)header.atoms ||
+                bondChanges[k].b < 0 || bondChanges[k].b >= (int)header.atoms)
+            in.ok = false;
+    }
+    if(!in.ok)
+        return false;
+
+    for(size_t k = 0; k < atomChanges.size(); k++)
+    {
+        size_t i = atomChanges[k].index;
+        qx[i] += (int32_t)atomChanges[k].dx;
+        qy[i] += (int32_t)atomChanges[k].dy;
+        frame.x[i] = qx[i] * quantum;
+        frame.y[i] = qy[i] * quantum;
+    }
+    frame.bondA.resize(header.bonds);
+    frame.bondB.resize(header.bonds);
+    frame.bondVisible.resize(header.bonds);
+    for(size_t k = 0; k < bondChanges.size(); k++)
+    {
+        size_t i = bondChanges[k].index;
+        frame.bondA[i] = bondChanges[k].a;
+        frame.bondB[i] = bondChanges[k].b;
+        frame.bondVisible[i] = bondChanges[k].visible;
+    }
+    applyHeader(header, frame);
+    return true;
+}
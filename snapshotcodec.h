@@ -0,0 +1,69 @@
+#ifndef SNAPSHOTCODEC_H
+#define SNAPSHOTCODEC_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "simtypes.h"
+
+// Quadros da simulacao em bytes, para os visualizadores. As posicoes sao
+// quantizadas (quantum unidades de cena) e o encoder lembra o ultimo
+// estado enviado: um quadro delta so leva os atomos cuja posicao
+// quantizada mudou e as ligacoes que mudaram. Atomo parado ou dormindo
+// nao custa nada. Quando muda o numero de atomos ou algum elemento, sai
+// um quadro completo (key).
+//
+// O mesmo delta serve para todos os visualizadores que ja tem o estado
+// anterior; quem chega depois recebe encodeKey() do estado atual e segue
+// com os deltas seguintes.
+//
+// Inteiros em varint (zigzag quando tem sinal), doubles crus em
+// little-endian.
+class SnapshotEncoder
+{
+public:
+    explicit SnapshotEncoder(double quantum = 1.0 / 16);
+
+    // Delta em relacao ao ultimo quadro codificado (key se nao houver).
+    // Retorna true se saiu um quadro completo.
+    bool encode(const SimFrame &frame, std::vector<uint8_t> &out);
+    // O estado atual inteiro, sem mexer no que foi enviado.
+    void encodeKey(std::vector<uint8_t> &out) const;
+    bool hasState() const { return haveState; }
+
+private:
+    double quantum;
+    bool haveState;
+
+    // ultimo estado enviado, ja quantizado
+    unsigned long long step;
+    SimStats stats;
+    SimBox box;
+    std::vector<int> element;
+    std::vector<int32_t> qx, qy;
+    std::vector<int> bondA, bondB;
+    std::vector<char> bondVisible;
+    size_t solutionAtoms, solutionBonds;
+    std::vector<uint8_t> scratch;
+
+    void writeHeader(uint8_t kind, std::vector<uint8_t> &out) const;
+};
+
+// Refaz o SimFrame a partir dos quadros, na ordem em que chegaram.
+class SnapshotDecoder
+{
+public:
+    SnapshotDecoder();
+
+    // false se a mensagem estiver truncada ou for um delta sem key antes;
+    // nesse caso o frame fica como estava e o proximo key conserta.
+    bool decode(const uint8_t *data, size_t size, SimFrame &frame);
+    bool hasKey() const { return haveKey; }
+
+private:
+    bool haveKey;
+    double quantum;
+    std::vector<int32_t> qx, qy;
+};
+
+#endif // SNAPSHOTCODEC_H
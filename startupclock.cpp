@@ -0,0 +1,96 @@
+#include "startupclock.h"
+#include "trace.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QVector>
+#include <QDebug>
+#include <atomic>
+
+namespace {
+
+struct Phase
+{
+    const char *name; // literal
+    qint64 start;     // ns desde start()
+    qint64 end;
+};
+
+QElapsedTimer startupTimer;
+QMutex phaseLock;
+QVector<Phase> phases;
+qint64 lastMark = 0;
+std::atomic<bool> finished(false);
+#ifdef COOKINGMETH_TRACE
+uint64_t traceStart = 0;
+#endif
+
+}
+
+void StartupClock::start()
+{
+    QMutexLocker locker(&phaseLock);
+    startupTimer.start();
+    phases.clear();
+    lastMark = 0;
+    finished = false;
+#ifdef COOKINGMETH_TRACE
+    traceStart = Trace::now();
+#endif
+}
+
+qint64 StartupClock::elapsed()
+{
+    return startupTimer.isValid() ? startupTimer.nsecsElapsed() : 0;
+}
+
+// Sem since a fase vai do mark anterior ate agora.
+void StartupClock::mark(const char *phase, qint64 since)
+{
+    if(finished.load() || !startupTimer.isValid())
+        return;
+
+    QMutexLocker locker(&phaseLock);
+    Phase p;
+    p.name = phase;
+    p.end = startupTimer.nsecsElapsed();
+    if(since < 0)
+    {
+        p.start = lastMark;
+        lastMark = p.end;
+    }
+    else
+        p.start = since;
+    phases.append(p);
+#ifdef COOKINGMETH_TRACE
+    Trace::record(phase, traceStart + p.start, traceStart + p.end);
+#endif
+}
+
+void StartupClock::finish(const char *phase)
+{
+    if(finished.load())
+        return;
+    mark(phase);
+    finished = true;
+    qDebug("%s", qPrintable(report()));
+}
+
+bool StartupClock::isFinished()
+{
+    return finished.load();
+}
+
+QString StartupClock::report()
+{
+    QMutexLocker locker(&phaseLock);
+    QString text = QString("abertura: %1 ms ate o primeiro quadro")
+            .arg(lastMark / 1e6, 0, 'f', 1);
+    // as fases de outra thread aparecem com o intervalo em que correram
+    foreach(const Phase &p, phases)
+        text += QString("\n  %1 %2 ms  (%3 - %4)").arg(QString(p.name), -24)
+                .arg((p.end - p.start) / 1e6, 7, 'f', 1)
+                .arg(p.start / 1e6, 0, 'f', 1)
+                .arg(p.end / 1e6, 0, 'f', 1);
+    return text;
+}
@@ -0,0 +1,22 @@
+#ifndef STARTUPCLOCK_H
+#define STARTUPCLOCK_H
+
+#include <QString>
+
+// Tempo ate o primeiro quadro. main() chama start() antes de tudo, cada
+// fase da abertura chama mark() quando termina e finish() fecha a conta
+// no primeiro quadro desenhado e imprime quanto cada fase levou. Uma fase
+// que corre em outra thread passa o proprio inicio (elapsed()) e nao
+// entra na sequencia. Com CONFIG+=trace as fases tambem vao para o trace.
+class StartupClock
+{
+public:
+    static void start();
+    static qint64 elapsed(); // ns
+    static void mark(const char *phase, qint64 since = -1);
+    static void finish(const char *phase);
+    static bool isFinished();
+    static QString report();
+};
+
+#endif // STARTUPCLOCK_H
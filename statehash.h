@@ -0,0 +1,40 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <cstddef>
+
+// FNV-1a de 64 bits sobre os bytes do estado. Os double entram bit a bit:
+// qualquer diferenca, ate na ultima casa, muda o valor. E o que a
+// verificacao do GoldenRun quer: saber se uma otimizacao mudou a conta.
+class StateHash
+{
+public:
+    StateHash() : hash(14695981039346656037ULL) {}
+
+    void add(const void *data, size_t bytes)
+    {
+        const unsigned char *p = (const unsigned char *)data;
+        for(size_t i = 0; i < bytes; i++)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    void add(double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        add(&bits, sizeof(bits));
+    }
+    void add(long long value) { add(&value, sizeof(value)); }
+    void add(int value) { add((long long)value); }
+
+    uint64_t value() const { return hash; }
+
+private:
+    uint64_t hash;
+};
+
+#endif // STATEHASH_H
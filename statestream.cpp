@@ -0,0 +1,146 @@
+#include "statestream.h"
+#include "trace.h"
+
+#include <QTimer>
+#include <string.h>
+
+StateServer::StateServer(QObject *parent)
+    : QObject(parent), sent(0), frames(0)
+{
+    connect(&server, SIGNAL(newConnection()), this, SLOT(acceptViewers()));
+}
+
+bool StateServer::listen(const QString &name)
+{
+    // um servidor que caiu deixa o arquivo do socket para tras no Unix
+    QLocalServer::removeServer(name);
+    return server.listen(name);
+}
+
+void StateServer::acceptViewers()
+{
+    while(QLocalSocket *socket = server.nextPendingConnection())
+    {
+        connect(socket, SIGNAL(disconnected()), this, SLOT(dropViewers()));
+        Viewer viewer;
+        viewer.socket = socket;
+        viewer.needsKey = true;
+        // com a simulacao parada nao vem quadro novo: o completo vai ja
+        if(encoder.hasState())
+        {
+            encoder.encodeKey(key);
+            send(socket, key);
+            viewer.needsKey = false;
+        }
+        viewers.append(viewer);
+    }
+}
+
+void StateServer::dropViewers()
+{
+    for(int i = viewers.size() - 1; i >= 0; i--)
+    {
+        if(viewers[i].socket->state() != QLocalSocket::ConnectedState)
+        {
+            viewers[i].socket->deleteLater();
+            viewers.removeAt(i);
+        }
+    }
+}
+
+void StateServer::publish(const SimFrame &frame)
+{
+    TRACE_ZONE("StateServer::publish");
+
+    // codifica sempre, com ou sem visualizador: quem chegar depois parte
+    // deste estado
+    bool isKey = encoder.encode(frame, delta);
+    bool keyReady = false;
+    frames++;
+
+    for(int i = 0; i < viewers.size(); i++)
+    {
+        Viewer &viewer = viewers[i];
+        qint64 backlog = viewer.socket->bytesToWrite();
+        if(viewer.needsKey)
+        {
+            if(backlog > MaxBacklog / 2)
+                continue;
+            if(isKey)
+                send(viewer.socket, delta);
+            else
+            {
+                if(!keyReady)
+                    encoder.encodeKey(key);
+                keyReady = true;
+                send(viewer.socket, key);
+            }
+            viewer.needsKey = false;
+        }
+        else if(backlog > MaxBacklog)
+            viewer.needsKey = true; // perde este e os proximos deltas
+        else
+            send(viewer.socket, delta);
+    }
+}
+
+void StateServer::send(QLocalSocket *socket, const std::vector<uint8_t> &message)
+{
+    uint32_t size = (uint32_t)message.size();
+    char prefix[4] = { (char)(size & 0xff), (char)((size >> 8) & 0xff),
+                       (char)((size >> 16) & 0xff), (char)((size >> 24) & 0xff) };
+    socket->write(prefix, 4);
+    socket->write((const char *)message.data(), message.size());
+    sent += 4 + message.size();
+}
+
+StateClient::StateClient(QObject *parent)
+    : QObject(parent)
+{
+    connect(&socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+    connect(&socket, SIGNAL(disconnected()), this, SLOT(reconnectLater()));
+    connect(&socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(reconnectLater()));
+}
+
+void StateClient::connectToServer(const QString &name)
+{
+    serverName = name;
+    reconnect();
+}
+
+void StateClient::reconnect()
+{
+    if(socket.state() != QLocalSocket::UnconnectedState)
+        return;
+    buffer.clear();
+    socket.connectToServer(serverName, QIODevice::ReadOnly);
+}
+
+void StateClient::reconnectLater()
+{
+    QTimer::singleShot(1000, this, SLOT(reconnect()));
+}
+
+void StateClient::readMessages()
+{
+    TRACE_ZONE("StateClient::readMessages");
+    buffer.append(socket.readAll());
+
+    // todas as mensagens inteiras que chegaram; o resto espera a proxima
+    bool changed = false;
+    int pos = 0;
+    while(buffer.size() - pos >= 4)
+    {
+        const uchar *head = (const uchar *)buffer.constData() + pos;
+        uint32_t size = head[0] | (head[1] << 8) | (head[2] << 16) | ((uint32_t)head[3] << 24);
+        if((uint32_t)(buffer.size() - pos - 4) < size)
+            break;
+        if(decoder.decode(head + 4, size, current))
+            changed = true;
+        pos += 4 + size;
+    }
+    buffer.remove(0, pos);
+
+    if(changed)
+        emit frameReady();
+}
@@ -0,0 +1,92 @@
+#ifndef STATESTREAM_H
+#define STATESTREAM_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QByteArray>
+#include <QList>
+#include <vector>
+
+#include "simtypes.h"
+#include "snapshotcodec.h"
+
+// Uma simulacao sem janela alimentando varias janelas na mesma maquina
+// (professor, projetor, alunos). O servidor codifica cada quadro uma vez
+// so (SnapshotEncoder) e manda os mesmos bytes para todos; cada mensagem
+// vai com o tamanho na frente (uint32 little-endian).
+//
+// Um visualizador lento nao segura os outros: se a fila dele passar de
+// MaxBacklog ele deixa de receber deltas e, quando a fila esvaziar,
+// recebe um quadro completo e volta a acompanhar.
+class StateServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StateServer(QObject *parent = 0);
+
+    bool listen(const QString &name);
+    QString errorString() const { return server.errorString(); }
+
+    void publish(const SimFrame &frame);
+
+    int viewerCount() const { return viewers.size(); }
+    qint64 bytesSent() const { return sent; }
+    qint64 framesSent() const { return frames; }
+
+private slots:
+    void acceptViewers();
+    void dropViewers();
+
+private:
+    enum { MaxBacklog = 1 << 20 };
+
+    struct Viewer
+    {
+        QLocalSocket *socket;
+        bool needsKey;
+    };
+
+    QLocalServer server;
+    QList<Viewer> viewers;
+    SnapshotEncoder encoder;
+    std::vector<uint8_t> delta;
+    std::vector<uint8_t> key;
+    qint64 sent;
+    qint64 frames;
+
+    void send(QLocalSocket *socket, const std::vector<uint8_t> &message);
+};
+
+// O lado do visualizador: le as mensagens, refaz o quadro e avisa com
+// frameReady() uma vez por leitura, mesmo que tenham chegado varias.
+// Se o servidor cair, tenta de novo a cada segundo.
+class StateClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StateClient(QObject *parent = 0);
+
+    void connectToServer(const QString &name);
+    bool hasFrame() const { return decoder.hasKey(); }
+    const SimFrame &frame() const { return current; }
+
+signals:
+    void frameReady();
+
+private slots:
+    void readMessages();
+    void reconnectLater();
+    void reconnect();
+
+private:
+    QLocalSocket socket;
+    QString serverName;
+    QByteArray buffer;
+    SnapshotDecoder decoder;
+    SimFrame current;
+};
+
+#endif // STATESTREAM_H
@@ -0,0 +1,108 @@
+#include "sweep.h"
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+bool SweepAxis::parse(const QString &text)
+{
+    QStringList parts = text.split(':');
+    bool ok = true;
+    if(parts.size() == 1)
+    {
+        min = max = parts[0].toDouble(&ok);
+        count = 1;
+        return ok;
+    }
+    if(parts.size() != 3)
+        return false;
+
+    bool okMin, okMax, okCount;
+    min = parts[0].toDouble(&okMin);
+    max = parts[1].toDouble(&okMax);
+    count = parts[2].toInt(&okCount);
+    return okMin && okMax && okCount && count > 0;
+}
+
+ParameterSweep::ParameterSweep()
+    : speed(2), spin(0), angle(0), distance(40),
+      repeats(20), steps(1500), speedJitter(0.1), spinJitter(0.5)
+{
+}
+
+int ParameterSweep::pointCount() const
+{
+    return speed.count * spin.count * angle.count * distance.count;
+}
+
+// A ordem das simulacoes no runner e ponto a ponto, `repeats` seguidas.
+void ParameterSweep::run()
+{
+    RunSpec spec;
+    spec.steps = steps;
+    spec.stopOnReaction = true;
+    spec.speedJitter = speedJitter;
+    spec.spinJitter = spinJitter;
+    spec.scenario = scenario;
+    spec.scenario.encounter = true;
+    spec.scenario.customReaction = true;
+
+    unsigned next = scenario.seed;
+    for(int p = 0; p < pointCount(); p++)
+    {
+        // a distancia varia mais rapido, a velocidade mais devagar
+        int i = p;
+        spec.scenario.reactionDistance = distance.value(i % distance.count);
+        i /= distance.count;
+        spec.scenario.approachAngle = angle.value(i % angle.count);
+        i /= angle.count;
+        spec.scenario.approachSpin = spin.value(i % spin.count);
+        i /= spin.count;
+        spec.scenario.approachSpeed = speed.value(i);
+        for(int r = 0; r < repeats; r++)
+        {
+            spec.seed = next++;
+            runner.addRun(spec);
+        }
+    }
+    runner.run();
+}
+
+bool ParameterSweep::writeTable(const QString &fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&file);
+    out << "speed,spin,angle,distance,speed_jitter,spin_jitter,runs,yield,"
+           "mean_steps,min_steps,max_steps\n";
+    for(int p = 0; p < pointCount(); p++)
+    {
+        const Scenario &scenario = runner.spec(p * repeats).scenario;
+        int reacted = 0;
+        long long sum = 0, first = -1, last = -1;
+        for(int r = 0; r < repeats; r++)
+        {
+            long long step = runner.result(p * repeats + r).reactionStep;
+            if(step < 0)
+                continue;
+            reacted++;
+            sum += step;
+            if(first < 0 || step < first)
+                first = step;
+            if(step > last)
+                last = step;
+        }
+
+        out << scenario.approachSpeed << ',' << scenario.approachSpin << ','
+            << scenario.approachAngle << ',' << scenario.reactionDistance << ','
+            << speedJitter << ',' << spinJitter << ','
+            << repeats << ',' << (repeats > 0 ? (double)reacted / repeats : 0) << ',';
+        if(reacted > 0)
+            out << (double)sum / reacted << ',' << first << ',' << last << '\n';
+        else
+            out << ",,\n";
+    }
+    return true;
+}
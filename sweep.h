@@ -0,0 +1,46 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <QString>
+#include <QVector>
+
+#include "ensemble.h"
+
+// Um eixo da grade: count valores de min a max, "0.5:3:6" ou so "2".
+struct SweepAxis
+{
+    double min, max;
+    int count;
+
+    SweepAxis(double value = 0) : min(value), max(value), count(1) {}
+    bool parse(const QString &text);
+    double value(int i) const { return count > 1 ? min + (max - min) * i / (count - 1) : min; }
+};
+
+// Varre velocidade de aproximacao, rotacao, orientacao e distancia de
+// reacao do encontro H-Cl + F. Cada ponto roda `repeats` vezes com
+// sementes diferentes; todas as simulacoes vao juntas para o
+// EnsembleRunner. A saida e uma linha por ponto com o rendimento e o
+// tempo ate a reacao.
+class ParameterSweep
+{
+public:
+    ParameterSweep();
+
+    SweepAxis speed, spin, angle, distance;
+    Scenario scenario;  // a cena em volta; seed e a da primeira simulacao
+    int repeats;
+    int steps;
+    double speedJitter;
+    double spinJitter;
+
+    void setThreads(int count) { runner.setThreads(count); }
+    int pointCount() const;
+    void run();
+    bool writeTable(const QString &fileName) const;
+
+private:
+    EnsembleRunner runner;
+};
+
+#endif // SWEEP_H
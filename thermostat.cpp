@@ -0,0 +1,63 @@
+#include "thermostat.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// o Berendsen nao mexe mais que isso por passo: sem tranco quando o alvo
+// muda muito de uma vez
+static const double MaxScaleStep = 0.1;
+
+Thermostat::Thermostat()
+    : type(Off), goal(0), tau(1), friction(1), random(1), gauss(0, 1)
+{
+    setCoupling(100);
+}
+
+void Thermostat::setKind(int kind)
+{
+    type = kind >= Off && kind < KindCount ? kind : Off;
+}
+
+void Thermostat::setCoupling(double steps)
+{
+    tau = std::max(1.0, steps);
+    friction = exp(-1 / tau);
+}
+
+const char *Thermostat::name(int kind)
+{
+    static const char *names[KindCount] = { "off", "berendsen", "rescale", "langevin" };
+    return kind >= Off && kind < KindCount ? names[kind] : "off";
+}
+
+int Thermostat::kindFromName(const char *name)
+{
+    for(int kind = Off; kind < KindCount; kind++)
+    {
+        if(strcmp(name, Thermostat::name(kind)) == 0)
+            return kind;
+    }
+    return -1;
+}
+
+double Thermostat::scaleFor(double temperature) const
+{
+    if(temperature <= 1e-12 || goal <= 0)
+        return 1;
+    if(type == Rescale)
+        return sqrt(goal / temperature);
+    if(type != Berendsen)
+        return 1;
+    double scale = sqrt(std::max(0.0, 1 + (goal / temperature - 1) / tau));
+    return std::min(1 + MaxScaleStep, std::max(1 - MaxScaleStep, scale));
+}
+
+// o empurrao que repoe o que o atrito tirou: no equilibrio cada
+// componente fica com m v^2 = alvo
+double Thermostat::kick(double mass)
+{
+    if(mass <= 0 || goal <= 0)
+        return 0;
+    return sqrt((1 - friction * friction) * goal / mass) * gauss(random);
+}
@@ -0,0 +1,53 @@
+#ifndef THERMOSTAT_H
+#define THERMOSTAT_H
+
+#include <random>
+
+// Segura a temperatura da cena perto de um alvo, para rodar horas sem a
+// energia escapar (a integracao e os choques sempre deixam um pouco de
+// deriva). A Simulation chama depois de cada passo; aqui so as contas.
+//
+//   Berendsen  multiplica as velocidades por um fator que leva T ao
+//              alvo aos poucos, com tempo de acoplamento coupling passos
+//   Rescale    o mesmo, mas chega ao alvo de uma vez a cada passo
+//   Langevin   atrito mais empurroes ao acaso; a unica que tira a cena
+//              do repouso, e a que da as flutuacoes certas
+//
+// Temperatura com k = 1, como Simulation::temperature().
+class Thermostat
+{
+public:
+    enum Kind { Off, Berendsen, Rescale, Langevin, KindCount };
+
+    Thermostat();
+
+    void setKind(int kind);
+    int kind() const { return type; }
+    bool isEnabled() const { return type != Off; }
+    void setTarget(double temperature) { goal = temperature; }
+    double target() const { return goal; }
+    void setCoupling(double steps);
+    double coupling() const { return tau; }
+    void seed(unsigned seed) { random.seed(seed); }
+
+    static const char *name(int kind);
+    static int kindFromName(const char *name); // -1 se nao conhece
+
+    // Berendsen e Rescale: o fator de todas as velocidades para quem esta
+    // a temperature agora; 1 quando nao ha o que medir
+    double scaleFor(double temperature) const;
+
+    // Langevin: v = damping() * v + kick(massa) (um por componente)
+    double damping() const { return friction; }
+    double kick(double mass);
+
+private:
+    int type;
+    double goal;
+    double tau;
+    double friction;
+    std::mt19937 random;
+    std::normal_distribution<double> gauss;
+};
+
+#endif // THERMOSTAT_H
@@ -0,0 +1,111 @@
+#include "trace.h"
+
+#ifdef COOKINGMETH_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+// Um anel por thread. So a dona escreve; quem grava o JSON le ate o
+// indice publicado. Os eventos mais antigos sao sobrescritos.
+struct TraceEvent
+{
+    const char *name;
+    uint64_t start;
+    uint64_t duration;
+};
+
+struct TraceBuffer
+{
+    enum { Size = 1 << 16, Mask = Size - 1 };
+
+    TraceEvent events[Size];
+    std::atomic<unsigned> written;
+    int thread;
+    const char *threadName;
+
+    TraceBuffer() : written(0), thread(0), threadName(0) {}
+};
+
+static std::mutex bufferLock;
+static std::vector<TraceBuffer *> buffers; // vivem ate o fim do programa
+static thread_local TraceBuffer *localBuffer = 0;
+
+static TraceBuffer *threadBuffer()
+{
+    if(!localBuffer)
+    {
+        localBuffer = new TraceBuffer;
+        std::lock_guard<std::mutex> locker(bufferLock);
+        localBuffer->thread = (int)buffers.size() + 1;
+        buffers.push_back(localBuffer);
+    }
+    return localBuffer;
+}
+
+uint64_t Trace::now()
+{
+    static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - origin).count();
+}
+
+void Trace::record(const char *name, uint64_t start, uint64_t end)
+{
+    TraceBuffer *buffer = threadBuffer();
+    unsigned index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->events[index & TraceBuffer::Mask];
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char *name)
+{
+    threadBuffer()->threadName = name;
+}
+
+// As zonas de uma thread terminam na ordem inversa de inicio, mas o
+// formato "X" (inicio + duracao) deixa o visualizador aninhar sozinho.
+bool Trace::writeChromeJson(const char *fileName)
+{
+    FILE *file = fopen(fileName, "w");
+    if(!file)
+        return false;
+
+    std::lock_guard<std::mutex> locker(bufferLock);
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for(size_t b = 0; b < buffers.size(); b++)
+    {
+        const TraceBuffer *buffer = buffers[b];
+        if(buffer->threadName)
+        {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                          "\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->thread, buffer->threadName);
+            first = false;
+        }
+
+        // deixa uma folga: a dona pode estar sobrescrevendo o comeco do anel
+        unsigned end = buffer->written.load(std::memory_order_acquire);
+        unsigned count = end < (unsigned)TraceBuffer::Size - 1024 ? end : TraceBuffer::Size - 1024;
+        for(unsigned i = end - count; i != end; i++)
+        {
+            const TraceEvent &event = buffer->events[i & TraceBuffer::Mask];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                          "\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, buffer->thread,
+                    event.start / 1000.0, event.duration / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+#endif // COOKINGMETH_TRACE
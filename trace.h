@@ -0,0 +1,46 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Zonas de trace escolhidas na compilacao: com CONFIG+=trace no qmake
+// (define COOKINGMETH_TRACE) cada TRACE_ZONE grava inicio e duracao num
+// anel da propria thread; sem isso a macro nao gera codigo nenhum.
+// Trace::writeChromeJson() grava tudo no formato do chrome://tracing e
+// do Perfetto.
+
+#ifdef COOKINGMETH_TRACE
+
+#include <stdint.h>
+
+class Trace
+{
+public:
+    static uint64_t now(); // ns
+    static void record(const char *name, uint64_t start, uint64_t end);
+    static void setThreadName(const char *name);
+    static bool writeChromeJson(const char *fileName);
+};
+
+class TraceZone
+{
+public:
+    explicit TraceZone(const char *zoneName) : name(zoneName), start(Trace::now()) {}
+    ~TraceZone() { Trace::record(name, start, Trace::now()); }
+
+private:
+    const char *name; // literal, so o ponteiro e guardado
+    uint64_t start;
+};
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_THREAD(name) Trace::setThreadName(name)
+
+#else
+
+#define TRACE_ZONE(name) do {} while(0)
+#define TRACE_THREAD(name) do {} while(0)
+
+#endif // COOKINGMETH_TRACE
+
+#endif // TRACE_H
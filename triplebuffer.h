@@ -0,0 +1,45 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Troca de estado entre uma thread que escreve e outra que le, sem lock.
+// O escritor sempre tem um buffer livre para escrever e o leitor sempre
+// tem o ultimo buffer completo; nenhum dos dois espera pelo outro.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : middle(1), back(2), front(0) {}
+
+    // lado do escritor
+    T &writeBuffer() { return slots[back]; }
+    void publish()
+    {
+        int previous = middle.exchange(back | DirtyBit, std::memory_order_acq_rel);
+        back = previous & IndexMask;
+    }
+    // o ultimo publicado ainda nao foi pego pelo leitor
+    bool pending() const { return middle.load(std::memory_order_relaxed) & DirtyBit; }
+
+    // lado do leitor: retorna true se havia um estado novo
+    bool update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & DirtyBit))
+            return false;
+        int previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & IndexMask;
+        return true;
+    }
+    const T &readBuffer() const { return slots[front]; }
+
+private:
+    enum { IndexMask = 3, DirtyBit = 4 };
+
+    T slots[3];
+    std::atomic<int> middle;
+    int back;
+    int front;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,51 @@
+#include "unionfind.h"
+
+int UnionFind::add()
+{
+    parent.push_back((int)parent.size());
+    size.push_back(1);
+    return (int)parent.size() - 1;
+}
+
+int UnionFind::find(int i)
+{
+    int root = i;
+    while(parent[root] != root)
+        root = parent[root];
+    while(parent[i] != root)
+    {
+        int next = parent[i];
+        parent[i] = root;
+        i = next;
+    }
+    return root;
+}
+
+int UnionFind::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if(a == b)
+        return a;
+    if(size[a] < size[b])
+    {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+    parent[b] = a;
+    size[a] += size[b];
+    return a;
+}
+
+void UnionFind::reset(int i)
+{
+    parent[i] = i;
+    size[i] = 1;
+}
+
+void UnionFind::attach(int i, int root)
+{
+    parent[i] = root;
+    size[root]++;
+}
@@ -0,0 +1,28 @@
+#ifndef UNIONFIND_H
+#define UNIONFIND_H
+
+#include <vector>
+#include <cstddef>
+
+// Conjuntos disjuntos com compressao de caminho e uniao por tamanho.
+// Diz rapido se dois atomos ja estao na mesma molecula quando uma
+// ligacao se forma. Quando uma ligacao quebra, quem chama refaz os dois
+// pedacos com reset()/attach().
+class UnionFind
+{
+public:
+    int add();
+    int find(int i);
+    int unite(int a, int b);
+
+    void reset(int i);
+    void attach(int i, int root);
+    int count() const { return (int)parent.size(); }
+    size_t memoryUsage() const { return (parent.capacity() + size.capacity()) * sizeof(int); }
+
+private:
+    std::vector<int> parent;
+    std::vector<int> size;
+};
+
+#endif // UNIONFIND_H